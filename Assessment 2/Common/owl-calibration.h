@@ -0,0 +1,173 @@
+#ifndef OWLCALIBRATION_H
+#define OWLCALIBRATION_H
+
+/* Binary stereo calibration bundle for the OWL
+ *
+ * Written by the StereoCalibration tool next to intrinsics.xml/extrinsics.xml. It holds
+ * the camera matrices, distortion, R/T, the rectification R1/R2/P1/P2/Q, the valid ROIs
+ * and the fixed point remap tables (CV_16SC2 + CV_16UC1) that the calibration preview
+ * used. Apps memory map the file and remap with the stored tables directly, no XML
+ * parsing, stereoRectify or initUndistortRectifyMap at start up.
+ *
+ * File layout (little endian, maps start on 64 byte boundaries):
+ *   OwlCalHeader
+ *   map11, map12 (left), map21, map22 (right)
+ */
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "owl-mmap.h"
+
+using namespace std;
+using namespace cv;
+
+#define OWLCAL_VERSION 1
+#define OWLCAL_MAXDIST 14
+
+struct OwlCalHeader {
+    char     Magic[8];  // "OWLCAL"
+    uint32_t Version;
+    int32_t  Width, Height;
+    int32_t  DistCount[2];
+    int32_t  Roi[2][4];
+    int32_t  Reserved;
+    double   M[2][9], D[2][OWLCAL_MAXDIST];
+    double   R[9], T[3], R1[9], R2[9], P1[12], P2[12], Q[16];
+    uint64_t MapOffset[4];  // map11, map12, map21, map22 from the start of the file
+};
+
+class OwlCalibration {
+public:
+    //Map a bundle, every Mat is a view into the mapping (copy-on-write)
+    bool open(const string &path){
+        if (!file.open(path)){
+            return false;
+        }
+        const OwlCalHeader *h = (const OwlCalHeader*)file.Data;
+        if (file.Size < sizeof(OwlCalHeader) || strncmp(h->Magic, "OWLCAL", 8) != 0 || h->Version != OWLCAL_VERSION
+                || h->DistCount[0] < 0 || h->DistCount[0] > OWLCAL_MAXDIST
+                || h->DistCount[1] < 0 || h->DistCount[1] > OWLCAL_MAXDIST){
+            cout << "Invalid or outdated calibration bundle " << path << endl;
+            file.close();
+            return false;
+        }
+        if (h->Width <= 0 || h->Height <= 0 || h->Width > 32767 || h->Height > 32767){
+            cout << "Invalid image size in calibration bundle " << path << endl;
+            file.close();
+            return false;
+        }
+        ImageSize = Size(h->Width, h->Height);
+        //the maps are CV_16SC2 and CV_16UC1 tables of the image size, each must lie past the header and inside the file
+        uint64_t area = (uint64_t)h->Width*h->Height;
+        uint64_t mapBytes[4] = { area*4, area*2, area*4, area*2 };
+        for (int i = 0; i < 4; i++){
+            if (h->MapOffset[i] < sizeof(OwlCalHeader) || h->MapOffset[i] > file.Size
+                    || mapBytes[i] > file.Size - h->MapOffset[i]){
+                cout << "Truncated calibration bundle " << path << endl;
+                file.close();
+                return false;
+            }
+        }
+
+        OwlCalHeader *w = (OwlCalHeader*)file.Data; //Mat wants non-const data
+        M1 = Mat(3, 3, CV_64F, w->M[0]);
+        M2 = Mat(3, 3, CV_64F, w->M[1]);
+        D1 = Mat(1, h->DistCount[0], CV_64F, w->D[0]);
+        D2 = Mat(1, h->DistCount[1], CV_64F, w->D[1]);
+        R  = Mat(3, 3, CV_64F, w->R);
+        T  = Mat(3, 1, CV_64F, w->T);
+        R1 = Mat(3, 3, CV_64F, w->R1);
+        R2 = Mat(3, 3, CV_64F, w->R2);
+        P1 = Mat(3, 4, CV_64F, w->P1);
+        P2 = Mat(3, 4, CV_64F, w->P2);
+        Q  = Mat(4, 4, CV_64F, w->Q);
+        Roi1 = Rect(h->Roi[0][0], h->Roi[0][1], h->Roi[0][2], h->Roi[0][3]);
+        Roi2 = Rect(h->Roi[1][0], h->Roi[1][1], h->Roi[1][2], h->Roi[1][3]);
+        Map11 = Mat(ImageSize, CV_16SC2, file.Data + h->MapOffset[0]);
+        Map12 = Mat(ImageSize, CV_16UC1, file.Data + h->MapOffset[1]);
+        Map21 = Mat(ImageSize, CV_16SC2, file.Data + h->MapOffset[2]);
+        Map22 = Mat(ImageSize, CV_16UC1, file.Data + h->MapOffset[3]);
+        return true;
+    }
+
+    bool isOpened() const { return file.isOpened(); }
+
+    //Write a bundle, rmap[k] are the CV_16SC2/CV_16UC1 maps from initUndistortRectifyMap
+    static bool save(const string &path, Size imageSize, const Mat cameraMatrix[2], const Mat distCoeffs[2],
+                     const Mat &R, const Mat &T, const Mat &R1, const Mat &R2, const Mat &P1, const Mat &P2, const Mat &Q,
+                     const Rect validRoi[2], const Mat rmap[2][2]){
+        OwlCalHeader h;
+        memset(&h, 0, sizeof(h));
+        strcpy(h.Magic, "OWLCAL");
+        h.Version = OWLCAL_VERSION;
+        h.Width = imageSize.width;
+        h.Height = imageSize.height;
+        for (int k = 0; k < 2; k++){
+            if (!copyDoubles(cameraMatrix[k], h.M[k], 9)) return false;
+            h.DistCount[k] = (int32_t)distCoeffs[k].total();
+            if (h.DistCount[k] > OWLCAL_MAXDIST || !copyDoubles(distCoeffs[k], h.D[k], h.DistCount[k])) return false;
+            h.Roi[k][0] = validRoi[k].x;
+            h.Roi[k][1] = validRoi[k].y;
+            h.Roi[k][2] = validRoi[k].width;
+            h.Roi[k][3] = validRoi[k].height;
+            if (rmap[k][0].type() != CV_16SC2 || rmap[k][1].type() != CV_16UC1
+                    || rmap[k][0].size() != imageSize || rmap[k][1].size() != imageSize){
+                cout << "Calibration bundle needs CV_16SC2 remap tables" << endl;
+                return false;
+            }
+        }
+        if (!copyDoubles(R, h.R, 9) || !copyDoubles(T, h.T, 3) || !copyDoubles(R1, h.R1, 9) || !copyDoubles(R2, h.R2, 9)
+                || !copyDoubles(P1, h.P1, 12) || !copyDoubles(P2, h.P2, 12) || !copyDoubles(Q, h.Q, 16)){
+            return false;
+        }
+
+        const Mat *maps[4] = { &rmap[0][0], &rmap[0][1], &rmap[1][0], &rmap[1][1] };
+        uint64_t offset = alignUp(sizeof(h));
+        for (int i = 0; i < 4; i++){
+            h.MapOffset[i] = offset;
+            offset = alignUp(offset + maps[i]->total()*maps[i]->elemSize());
+        }
+
+        ofstream out(path.c_str(), ios::binary | ios::trunc);
+        if (!out.is_open()){
+            cout << "Can not write " << path << endl;
+            return false;
+        }
+        out.write((const char*)&h, sizeof(h));
+        for (int i = 0; i < 4; i++){
+            out.seekp((streamoff)h.MapOffset[i]);
+            for (int r = 0; r < maps[i]->rows; r++){
+                out.write((const char*)maps[i]->ptr(r), (streamsize)(maps[i]->cols*maps[i]->elemSize()));
+            }
+        }
+        return out.good();
+    }
+
+    Size ImageSize;
+    Mat M1, D1, M2, D2, R, T, R1, R2, P1, P2, Q;
+    Rect Roi1, Roi2;
+    Mat Map11, Map12, Map21, Map22;
+
+private:
+    static uint64_t alignUp(uint64_t v){ return (v + 63) & ~(uint64_t)63; }
+
+    static bool copyDoubles(const Mat &m, double *dst, int count){
+        if ((int)m.total() != count){
+            cout << "Unexpected matrix size in calibration bundle" << endl;
+            return false;
+        }
+        Mat d;
+        m.reshape(1, 1).convertTo(d, CV_64F);
+        memcpy(dst, d.ptr<double>(), count*sizeof(double));
+        return true;
+    }
+
+    OwlMappedFile file;
+};
+
+#endif // OWLCALIBRATION_H
@@ -0,0 +1,157 @@
+#ifndef OWLDATASET_H
+#define OWLDATASET_H
+
+/* Decoded image store for the OWL sample data sets
+ *
+ * Images are decoded once by the DatasetPack tool and written as raw pixels into a
+ * single .owlpack file, which the apps memory map and hand out as Mat views.
+ * Nothing is copied or decoded on the hot path.
+ *
+ * File layout (little endian, every frame starts on a 64 byte boundary):
+ *   OwlPackHeader
+ *   OwlPackEntry[count]
+ *   raw frame data
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdint.h>
+#include <string.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "owl-mmap.h"
+
+using namespace std;
+using namespace cv;
+
+#define OWLPACK_VERSION 1
+#define OWLPACK_ALIGN   64
+
+struct OwlPackHeader {
+    char     Magic[8];  // "OWLPACK"
+    uint32_t Version;
+    uint32_t Count;
+};
+
+struct OwlPackEntry {
+    char     Name[96];  // relative path without extension, e.g. "Target1/left30cm"
+    int32_t  Rows, Cols, Type, Reserved;
+    uint64_t Step;
+    uint64_t Offset;    // from the start of the file
+};
+
+class OwlDataset {
+public:
+    OwlDataset() : entries(0), count(0){}
+
+    bool open(const string &path){
+        entries = 0;
+        count = 0;
+        if (!file.open(path)){
+            return false;
+        }
+        const OwlPackHeader *h = (const OwlPackHeader*)file.Data;
+        if (file.Size < sizeof(OwlPackHeader) || strncmp(h->Magic, "OWLPACK", 8) != 0 || h->Version != OWLPACK_VERSION
+                || file.Size < sizeof(OwlPackHeader) + h->Count*sizeof(OwlPackEntry)){
+            cout << "Invalid or outdated dataset " << path << endl;
+            file.close();
+            return false;
+        }
+        const OwlPackEntry *index = (const OwlPackEntry*)(file.Data + sizeof(OwlPackHeader));
+        for (uint32_t i = 0; i < h->Count; i++){
+            const OwlPackEntry &e = index[i];
+            uint64_t rowBytes = (uint64_t)max(e.Cols, 0)*CV_ELEM_SIZE(e.Type);
+            if (!memchr(e.Name, 0, sizeof(e.Name)) || e.Rows <= 0 || e.Cols <= 0 || e.Step < rowBytes || e.Offset > file.Size
+                    || (file.Size - e.Offset)/e.Step < (uint64_t)e.Rows){
+                cout << "Truncated or corrupt dataset " << path << endl;
+                file.close();
+                return false;
+            }
+        }
+        count = (int)h->Count;
+        entries = index;
+        return true;
+    }
+
+    bool isOpened() const { return file.isOpened(); }
+    int size() const { return count; }
+    string name(int i) const { return entries[i].Name; }
+
+    //Zero copy view of frame i, backed by the mapping (copy-on-write, so writes stay private)
+    Mat frame(int i) const {
+        const OwlPackEntry &e = entries[i];
+        return Mat(e.Rows, e.Cols, e.Type, file.Data + e.Offset, (size_t)e.Step);
+    }
+
+    //Frame by name, or an empty Mat if the name is not in the store
+    Mat frame(const string &name) const {
+        for (int i = 0; i < count; i++){
+            if (name == entries[i].Name){
+                return frame(i);
+            }
+        }
+        return Mat();
+    }
+
+    //Decode every file and write them into one store, names[i] is the key for files[i]
+    static bool pack(const string &path, const vector<string> &files, const vector<string> &names){
+        CV_Assert(files.size() == names.size());
+        vector<OwlPackEntry> index(files.size());
+        vector<Mat> frames(files.size());
+
+        uint64_t offset = alignUp(sizeof(OwlPackHeader) + index.size()*sizeof(OwlPackEntry));
+        for (size_t i = 0; i < files.size(); i++){
+            frames[i] = imread(files[i], IMREAD_COLOR); //same decode as the apps' imread(path) fallback
+            if (frames[i].empty() || names[i].size() >= sizeof(index[i].Name)){
+                cout << "Can not pack " << files[i] << endl;
+                return false;
+            }
+            OwlPackEntry &e = index[i];
+            memset(&e, 0, sizeof(e));
+            strcpy(e.Name, names[i].c_str());
+            e.Rows = frames[i].rows;
+            e.Cols = frames[i].cols;
+            e.Type = frames[i].type();
+            e.Step = frames[i].cols*frames[i].elemSize();
+            e.Offset = offset;
+            offset = alignUp(offset + e.Rows*e.Step);
+        }
+
+        ofstream out(path.c_str(), ios::binary | ios::trunc);
+        if (!out.is_open()){
+            cout << "Can not write " << path << endl;
+            return false;
+        }
+        OwlPackHeader h;
+        memset(&h, 0, sizeof(h));
+        strcpy(h.Magic, "OWLPACK");
+        h.Version = OWLPACK_VERSION;
+        h.Count = (uint32_t)index.size();
+        out.write((const char*)&h, sizeof(h));
+        if (!index.empty()){
+            out.write((const char*)&index[0], index.size()*sizeof(OwlPackEntry));
+        }
+        for (size_t i = 0; i < frames.size(); i++){
+            out.seekp((streamoff)index[i].Offset);
+            for (int r = 0; r < frames[i].rows; r++){
+                out.write((const char*)frames[i].ptr(r), (streamsize)index[i].Step);
+            }
+        }
+        //Pad the file so the last frame is fully inside the mapping
+        out.seekp((streamoff)offset - 1);
+        out.put(0);
+        return out.good();
+    }
+
+private:
+    static uint64_t alignUp(uint64_t v){ return (v + OWLPACK_ALIGN - 1) & ~(uint64_t)(OWLPACK_ALIGN - 1); }
+
+    OwlMappedFile file;
+    const OwlPackEntry *entries;
+    int count;
+};
+
+#endif // OWLDATASET_H
@@ -0,0 +1,107 @@
+#ifndef OWLMMAP_H
+#define OWLMMAP_H
+
+/* Read-only memory mapped file for the OWL data stores
+ *
+ * The file is mapped copy-on-write, so a Mat view that is accidentally written to
+ * only dirties a private page and never the file on disk.
+ * Linux uses mmap, win32 uses a file mapping object.
+ */
+#ifdef _WIN32
+# ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+# endif
+# include <windows.h>
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+#include <string>
+
+using namespace std;
+
+class OwlMappedFile {
+public:
+    OwlMappedFile() : Data(0), Size(0){
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#endif
+    }
+    ~OwlMappedFile(){ close(); }
+
+    bool open(const string &path){
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE){
+            return false;
+        }
+        LARGE_INTEGER len;
+        if (!GetFileSizeEx(file, &len) || len.QuadPart == 0){
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (mapping == NULL){
+            close();
+            return false;
+        }
+        Data = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        if (Data == NULL){
+            close();
+            return false;
+        }
+        Size = (size_t)len.QuadPart;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0){
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0){
+            ::close(fd);
+            return false;
+        }
+        void *p = mmap(0, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd); //the mapping keeps its own reference to the file
+        if (p == MAP_FAILED){
+            return false;
+        }
+        Data = (unsigned char*)p;
+        Size = (size_t)st.st_size;
+#endif
+        return true;
+    }
+
+    void close(){
+#ifdef _WIN32
+        if (Data) UnmapViewOfFile(Data);
+        if (mapping != NULL) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (Data) munmap(Data, Size);
+#endif
+        Data = 0;
+        Size = 0;
+    }
+
+    bool isOpened() const { return Data != 0; }
+
+    unsigned char *Data;
+    size_t Size;
+
+private:
+    OwlMappedFile(const OwlMappedFile&);            //not copyable, the mapping has one owner
+    OwlMappedFile &operator=(const OwlMappedFile&);
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+};
+
+#endif // OWLMMAP_H
@@ -0,0 +1,121 @@
+#ifndef OWLVERGENCE_H
+#define OWLVERGENCE_H
+
+/* Depth from vergence for the OWL
+ *
+ * Once both eyes fixate the same target the range follows from the angle between them and
+ * the inter-pupillary distance alone, no rectification or disparity image is needed:
+ *   vergence angle   g = Gain*((Lx - LxC) - (Rx - RxC)) + Offset   (radians, > 0 converging)
+ *   distance         Z = IPD/(2 tan(g/2))                           (units of IPD)
+ * The Lx PWM grows as the left eye turns right and Rx as the right eye turns right, so the
+ * PWM difference grows as the eyes turn in. Gain starts from the nominal servo response and
+ * Offset from eyes that are parallel at the centre positions, calibrate() fits both to
+ * fixations at known distances. The centre positions are the robot's servo centres from
+ * owl-pwm.h, so only the fit is saved and a loaded model keeps the centres it was built with.
+ */
+#include <vector>
+#include <string>
+#include <math.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+struct OwlVergenceSample {
+    int Lx, Rx;        // servo positions with both eyes on the target
+    double Distance;   // known distance, units of IPD
+};
+
+class OwlVergence {
+public:
+    OwlVergence(double ipd, double deg2pwm, int lxC, int rxC)
+        : Ipd(ipd), Gain(CV_PI/180/deg2pwm), Offset(0), LxC(lxC), RxC(rxC){}
+
+    //Vergence angle in radians for a pair of servo positions
+    double angle(int lx, int rx) const {
+        return Gain*((lx - LxC) - (rx - RxC)) + Offset;
+    }
+
+    //Distance to the fixated target, <0 when the eyes do not converge
+    double distance(int lx, int rx) const {
+        double g = angle(lx, rx);
+        return g > 0 ? Ipd/(2*tan(g/2)) : -1;
+    }
+
+    //Least squares fit of Gain and Offset to the vergence angles of the known distances
+    bool calibrate(const vector<OwlVergenceSample> &samples){
+        double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (size_t i = 0; i < samples.size(); i++){
+            double x = (samples[i].Lx - LxC) - (samples[i].Rx - RxC);
+            double y = 2*atan(Ipd/(2*samples[i].Distance));
+            n++; sx += x; sy += y; sxx += x*x; sxy += x*y;
+        }
+        double den = n*sxx - sx*sx;
+        if (n < 2 || den <= 0){
+            return false;
+        }
+        Gain = (n*sxy - sx*sy)/den;
+        Offset = (sy - Gain*sx)/n;
+        return true;
+    }
+
+    bool save(const string &path) const {
+        FileStorage fs(path, FileStorage::WRITE);
+        if (!fs.isOpened()){
+            return false;
+        }
+        fs << "Ipd" << Ipd << "Gain" << Gain << "Offset" << Offset;
+        return true;
+    }
+
+    bool load(const string &path){
+        FileStorage fs(path, FileStorage::READ);
+        if (!fs.isOpened()){
+            return false;
+        }
+        fs["Ipd"] >> Ipd;
+        fs["Gain"] >> Gain;
+        fs["Offset"] >> Offset;
+        return true;
+    }
+
+    double Ipd;      // inter-pupillary distance
+    double Gain;     // radians of vergence per PWM step
+    double Offset;   // vergence angle with both eyes at their centre positions
+    int LxC, RxC;    // centre positions the PWM difference is taken from
+};
+
+//Where the target window of the left image is in the right image, so the right eye can be
+//turned onto it. Searched maxShift pixels to the left (nearer targets sit further left in the
+//right eye), a little to the right and 16 rows up and down for the unrectified vertical offset.
+//Returns the offset in pixels with a sub-pixel x, and the NCC of the match in score if given
+inline Point2f Owl_fixationOffset(const Mat &left, const Mat &right, Rect target, int maxShift, float *score = 0){
+    Rect image(0, 0, right.cols, right.rows);
+    target &= Rect(0, 0, left.cols, left.rows);
+    Rect search = Rect(target.x - maxShift, target.y - 16, target.width + maxShift + 16, target.height + 32) & image;
+    if (target.area() == 0 || search.width < target.width || search.height < target.height){
+        if (score) *score = 0;
+        return Point2f(0, 0);
+    }
+
+    Mat ncc;
+    matchTemplate(right(search), left(target), ncc, TM_CCOEFF_NORMED);
+    double best;
+    Point loc;
+    minMaxLoc(ncc, 0, &best, 0, &loc);
+
+    //Parabola through the peak and its horizontal neighbours
+    float dx = 0;
+    if (loc.x > 0 && loc.x < ncc.cols - 1){
+        const float *s = ncc.ptr<float>(loc.y);
+        float den = s[loc.x - 1] - 2*s[loc.x] + s[loc.x + 1];
+        if (den < 0){
+            dx = 0.5f*(s[loc.x - 1] - s[loc.x + 1])/den;
+        }
+    }
+    if (score) *score = (float)best;
+    return Point2f(search.x + loc.x + dx - target.x, (float)(search.y + loc.y - target.y));
+}
+
+#endif // OWLVERGENCE_H
@@ -4,6 +4,8 @@ CONFIG -= app_bundle
 CONFIG -= qt
 
 INCLUDEPATH += C:\openCV343\release\install\include
+INCLUDEPATH += ../../../Common
+INCLUDEPATH += "../../Task III/Projects/Assignment2iii"
 
 LIBS+= C:\openCV343\release\bin\libopencv_core343.dll
 LIBS+= C:\openCV343\release\bin\libopencv_highgui343.dll
@@ -17,4 +19,12 @@ LIBS +=-lws2_32 \
 SOURCES += \
     main.cpp
 
+HEADERS += \
+    owl-depth.h \
+    "../../Task III/Projects/Assignment2iii/owl-pwm.h" \
+    ../../../Common/owl-mmap.h \
+    ../../../Common/owl-dataset.h \
+    ../../../Common/owl-calibration.h \
+    ../../../Common/owl-vergence.h
+
 
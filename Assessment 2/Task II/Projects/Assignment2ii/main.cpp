@@ -22,17 +22,40 @@ Use this code as a base for your assignment.
 
 #include <stdio.h>
 
+#include "owl-pwm.h"
+#include "owl-depth.h"
+#include "owl-dataset.h"
+#include "owl-calibration.h"
+#include "owl-vergence.h"
+
 using namespace cv;
 using namespace std;
 
 int Distance=30;
 int targetType=1;
 
+#define DEPTH_UNITS 0.1 //the calibration T is in mm, distances are in cm
+#define PX2DEG  0.0768
+#define DEG2PWM 10.730
+#define IPD 58.3
+
+bool LoadPair(OwlDataset &dataset, bool packed, int target, int distance, Mat &left, Mat &right);
+void SetupSGBM(Ptr<StereoSGBM> &sgbm, int cn, int sgbmWinSize, int numberOfDisparities);
+int Vergence(OwlDataset &dataset, bool packed, const Mat &map11, const Mat &map12, const Mat &map21, const Mat &map22,
+             Ptr<StereoSGBM> &sgbm, int numberOfDisparities, float depthConstant);
+
 int main(int argc, char** argv)
 {
+    CommandLineParser parser(argc, argv, "{vergence||calibrate depth from vergence on the distance targets and compare it with SGBM}"
+                                         "{help||}");
+    if(parser.has("help")){
+        parser.printMessage();
+        return 0;
+    }
 
     string intrinsic_filename = "../../Data/intrinsics.xml";
     string extrinsic_filename = "../../Data/extrinsics.xml";
+    string bundle_filename = "../../Data/calibration.owlcal";
 
     int SADWindowSize=3;
     int numberOfDisparities=256;
@@ -60,72 +83,88 @@ int main(int argc, char** argv)
     Mat Q;
     Size img_size = {640,480};
 
-    FileStorage fs(intrinsic_filename, FileStorage::READ);
-    if(!fs.isOpened()){
-        printf("Failed to open file %s\n", intrinsic_filename.c_str());
-        return -1;
-    }
+    Mat map11, map12, map21, map22;
 
-    Mat M1, D1, M2, D2;
-    fs["M1"] >> M1;
-    fs["D1"] >> D1;
-    fs["M2"] >> M2;
-    fs["D2"] >> D2;
+    //The binary bundle written by the calibration tool has the remap tables ready to use
+    OwlCalibration bundle;
+    if(scale == 1 && bundle.open(bundle_filename) && bundle.ImageSize == img_size){
+        Q = bundle.Q;
+        roi1 = bundle.Roi1;
+        roi2 = bundle.Roi2;
+        map11 = bundle.Map11;
+        map12 = bundle.Map12;
+        map21 = bundle.Map21;
+        map22 = bundle.Map22;
+    }else{
+        printf("No calibration bundle, computing rectification from %s\n", extrinsic_filename.c_str());
+        FileStorage fs(intrinsic_filename, FileStorage::READ);
+        if(!fs.isOpened()){
+            printf("Failed to open file %s\n", intrinsic_filename.c_str());
+            return -1;
+        }
 
-    M1 *= scale;
-    M2 *= scale;
+        Mat M1, D1, M2, D2;
+        fs["M1"] >> M1;
+        fs["D1"] >> D1;
+        fs["M2"] >> M2;
+        fs["D2"] >> D2;
 
-    fs.open(extrinsic_filename, FileStorage::READ);
-    if(!fs.isOpened())
-    {
-        printf("Failed to open file %s\n", extrinsic_filename.c_str());
-        return -1;
-    }
-    Mat R, T, R1, P1, R2, P2;
-    fs["R"] >> R;
-    fs["T"] >> T;
+        M1 *= scale;
+        M2 *= scale;
 
-    stereoRectify( M1, D1, M2, D2, img_size, R, T, R1, R2, P1, P2, Q, CALIB_ZERO_DISPARITY, -1, img_size, &roi1, &roi2 );
+        fs.open(extrinsic_filename, FileStorage::READ);
+        if(!fs.isOpened())
+        {
+            printf("Failed to open file %s\n", extrinsic_filename.c_str());
+            return -1;
+        }
+        Mat R, T, R1, P1, R2, P2;
+        fs["R"] >> R;
+        fs["T"] >> T;
 
-    Mat map11, map12, map21, map22;
-    initUndistortRectifyMap(M1, D1, R1, P1, img_size, CV_16SC2, map11, map12);
-    initUndistortRectifyMap(M2, D2, R2, P2, img_size, CV_16SC2, map21, map22);
+        stereoRectify( M1, D1, M2, D2, img_size, R, T, R1, R2, P1, P2, Q, CALIB_ZERO_DISPARITY, -1, img_size, &roi1, &roi2 );
+
+        initUndistortRectifyMap(M1, D1, R1, P1, img_size, CV_16SC2, map11, map12);
+        initUndistortRectifyMap(M2, D2, R2, P2, img_size, CV_16SC2, map21, map22);
+    }
 
+    //focal length * baseline for a 1/16 pixel disparity, from the rectification in use
+    //(distance = Q(2,3)/(Q(3,2)*disparity)), so the bundle and the xml fallback both range correctly
+    float depthConstant = (float)(16*Q.at<double>(2,3)/Q.at<double>(3,2)*DEPTH_UNITS);
 
-    Mat Frame,Left,Right, disp, disp8;
+    //Use the decoded image store if it has been built with the DatasetPack tool
+    OwlDataset dataset;
+    bool packed = dataset.open("../../Data/targets.owlpack");
+    if(!packed){
+        cout<<"No dataset store found, decoding images from file"<<endl;
+    }
+
+    Mat Frame,LeftRaw,RightRaw,Left,Right, disp, disp8;
     Ptr<StereoSGBM> sgbm = StereoSGBM::create(0,16,3);
 
-    while (1){
+    if(parser.has("vergence")){
+        SetupSGBM(sgbm, 3, SADWindowSize, numberOfDisparities);
+        return Vergence(dataset, packed, map11, map12, map21, map22, sgbm, numberOfDisparities, depthConstant);
+    }
 
-        //Load images from file
-        String LeftPath ="../../Data/Task 2 Distance Targets/Target"+to_string(targetType)+"/left" +to_string(Distance)+"cm.jpg";
-        String RightPath="../../Data/Task 2 Distance Targets/Target"+to_string(targetType)+"/right"+to_string(Distance)+"cm.jpg";
+    while (1){
 
-        Left =imread(LeftPath );
-        Right=imread(RightPath);
+        //Load images from the store (zero copy views) or from file
+        LoadPair(dataset, packed, targetType, Distance, LeftRaw, RightRaw);
 
         cout<<"Distance: "<<Distance<<"cm   \t Target: "<<targetType<<endl;
 
         //Distort image to correct for lens/positional distortion
-        remap(Left, Left, map11, map12, INTER_LINEAR);
-        remap(Right, Right, map21, map22, INTER_LINEAR);
+        //(remap into separate images, the raw images may be views of the store)
+        remap(LeftRaw, Left, map11, map12, INTER_LINEAR);
+        remap(RightRaw, Right, map21, map22, INTER_LINEAR);
 
         //Match left and right images to create disparity image
         numberOfDisparities = numberOfDisparities > 0 ? numberOfDisparities : ((img_size.width/8) + 15) & -16;
         int cn = Left.channels();
         int sgbmWinSize = SADWindowSize > 0 ? SADWindowSize : 3;
 
-        sgbm->setBlockSize(sgbmWinSize);
-        sgbm->setPreFilterCap(63);
-        sgbm->setP1(8*cn*sgbmWinSize*sgbmWinSize);
-        sgbm->setP2(32*cn*sgbmWinSize*sgbmWinSize);
-        sgbm->setMinDisparity(0);
-        sgbm->setNumDisparities(numberOfDisparities);
-        sgbm->setUniquenessRatio(10);
-        sgbm->setSpeckleWindowSize(100);
-        sgbm->setSpeckleRange(32);
-        sgbm->setDisp12MaxDiff(1);
-        sgbm->setMode(StereoSGBM::MODE_SGBM);
+        SetupSGBM(sgbm, cn, sgbmWinSize, numberOfDisparities);
 
         sgbm->compute(Left, Right, disp);
 
@@ -137,7 +176,7 @@ int main(int argc, char** argv)
             for (int j = 0; j < depth.cols; j++) {
                 ushort val = disp.at<ushort>(i,j); //Get disparity value
                 val = val == 0 ? 1 : val; //Avoid divide-by-zero error
-                depth.at<ushort>(i,j) = (60967.69/val); //Get depth by dividing constant by disparity
+                depth.at<ushort>(i,j) = (depthConstant/val); //Get depth by dividing constant by disparity
             }
         }
 
@@ -149,8 +188,11 @@ int main(int argc, char** argv)
         imshow("disparity", disp8);
         imshow("depth", depthNorm);
 
-        //Print Distance to Center pixel
-        cout << "Distance to Center: " << depth.at<ushort>(depth.rows/2, depth.cols/2) << "\n" <<endl;
+        //Print robust distance to a window at the center of the image
+        Rect centre(img_size.width/2-32, img_size.height/2-32, 64, 64);
+        OwlRange range = Owl_regionDistance(disp, centre, depthConstant, numberOfDisparities);
+        cout << "Distance to Center: " << range.Distance << "  (disparity " << range.Disparity
+             << "px, confidence " << range.Confidence << ")\n" << endl;
 
         //keyboard Controls
         int key=waitKey(10);
@@ -179,7 +221,134 @@ int main(int argc, char** argv)
     return 0;
 }
 
+//Load a distance target pair from the store (zero copy views) or from file
+bool LoadPair(OwlDataset &dataset, bool packed, int target, int distance, Mat &left, Mat &right){
+    String LeftName ="Target"+to_string(target)+"/left" +to_string(distance)+"cm";
+    String RightName="Target"+to_string(target)+"/right"+to_string(distance)+"cm";
+
+    if(packed){
+        left =dataset.frame(LeftName );
+        right=dataset.frame(RightName);
+    }else{
+        left =imread("../../Data/Task 2 Distance Targets/"+LeftName +".jpg");
+        right=imread("../../Data/Task 2 Distance Targets/"+RightName+".jpg");
+    }
+    return !left.empty() && !right.empty();
+}
 
+void SetupSGBM(Ptr<StereoSGBM> &sgbm, int cn, int sgbmWinSize, int numberOfDisparities){
+    sgbm->setBlockSize(sgbmWinSize);
+    sgbm->setPreFilterCap(63);
+    sgbm->setP1(8*cn*sgbmWinSize*sgbmWinSize);
+    sgbm->setP2(32*cn*sgbmWinSize*sgbmWinSize);
+    sgbm->setMinDisparity(0);
+    sgbm->setNumDisparities(numberOfDisparities);
+    sgbm->setUniquenessRatio(10);
+    sgbm->setSpeckleWindowSize(100);
+    sgbm->setSpeckleRange(32);
+    sgbm->setDisp12MaxDiff(1);
+    sgbm->setMode(StereoSGBM::MODE_SGBM);
+}
+
+//Calibrate depth from vergence on the distance targets and compare it with SGBM on the same pairs
+//There is no robot here, so the fixation is simulated: the left eye stays on the target at its centre
+//position and the right eye is turned by the offset the target window is matched at, in PWM steps.
+//Each target is predicted by a model fitted to the other two, the model fitted to all three is saved
+int Vergence(OwlDataset &dataset, bool packed, const Mat &map11, const Mat &map12, const Mat &map21, const Mat &map22,
+             Ptr<StereoSGBM> &sgbm, int numberOfDisparities, float depthConstant){
+    struct Fixation {
+        int Target;
+        OwlVergenceSample Sample;
+        float Score;
+        float Sgbm;
+    };
+
+    const double pwmPerPx = PX2DEG*DEG2PWM;
+    OwlVergence model(IPD, DEG2PWM, LxC, RxC);
+    Rect centre(320-32, 240-32, 64, 64);
+    vector<Fixation> fixations;
+    double vergenceMs = 0, sgbmMs = 0;
+
+    Mat LeftRaw, RightRaw, Left, Right, disp;
+    for(int target=1; target<=3; target++){
+        for(int distance=30; distance<=150; distance+=10){
+            if(!LoadPair(dataset, packed, target, distance, LeftRaw, RightRaw)){
+                printf("Missing Target%d at %dcm\n", target, distance);
+                continue;
+            }
+            Fixation f;
+            f.Target = target;
+
+            //Vergence works on the raw images, matching is all it needs
+            int64 t = getTickCount();
+            Point2f offset = Owl_fixationOffset(LeftRaw, RightRaw, centre, 200, &f.Score);
+            f.Sample.Lx = model.LxC;
+            f.Sample.Rx = model.RxC + cvRound(offset.x*pwmPerPx);
+            f.Sample.Distance = distance*10.0; //cm to the mm of the IPD
+            vergenceMs += (getTickCount()-t)*1000./getTickFrequency();
+
+            t = getTickCount();
+            remap(LeftRaw, Left, map11, map12, INTER_LINEAR);
+            remap(RightRaw, Right, map21, map22, INTER_LINEAR);
+            sgbm->compute(Left, Right, disp);
+            f.Sgbm = Owl_regionDistance(disp, centre, depthConstant, numberOfDisparities).Distance;
+            sgbmMs += (getTickCount()-t)*1000./getTickFrequency();
+
+            fixations.push_back(f);
+        }
+    }
+    if(fixations.size() < 2){
+        printf("Not enough distance targets to calibrate\n");
+        return -1;
+    }
 
+    printf("target  distance  Rx-RxC  match  vergence  SGBM  (cm, each target predicted by the other two)\n");
+    double vergenceErr = 0, sgbmErr = 0;
+    int vergenceN = 0, sgbmN = 0;
+    for(int target=1; target<=3; target++){
+        vector<OwlVergenceSample> train;
+        for(size_t i=0; i<fixations.size(); i++){
+            if(fixations[i].Target != target) train.push_back(fixations[i].Sample);
+        }
+        OwlVergence fold = model;
+        if(!fold.calibrate(train)) continue;
+
+        for(size_t i=0; i<fixations.size(); i++){
+            const Fixation &f = fixations[i];
+            if(f.Target != target) continue;
+            double truth = f.Sample.Distance/10;
+            double estimate = fold.distance(f.Sample.Lx, f.Sample.Rx)/10;
+            printf("%6d  %8.0f  %6d  %5.2f  %8.1f  %4.1f\n", target, truth, f.Sample.Rx-model.RxC, f.Score, estimate, f.Sgbm);
+            if(estimate > 0){
+                vergenceErr += (estimate-truth)*(estimate-truth);
+                vergenceN++;
+            }
+            if(f.Sgbm > 0){
+                sgbmErr += (f.Sgbm-truth)*(f.Sgbm-truth);
+                sgbmN++;
+            }
+        }
+    }
 
+    vector<OwlVergenceSample> all;
+    for(size_t i=0; i<fixations.size(); i++){
+        all.push_back(fixations[i].Sample);
+    }
+    if(!model.calibrate(all)){
+        printf("Vergence calibration failed, the PWM positions do not change with distance\n");
+        return -1;
+    }
+    String path = "../../Data/vergence.xml";
+    if(!model.save(path)){
+        printf("Can not write %s\n", path.c_str());
+    }
 
+    int n = (int)fixations.size();
+    printf("\nVergence model: %.4f deg/PWM (nominal %.4f), %.3f deg at the centre positions, saved to %s\n",
+           model.Gain*180/CV_PI, 1/DEG2PWM, model.Offset*180/CV_PI, path.c_str());
+    printf("Vergence: RMS error %.1fcm over %d/%d pairs, %.2fms per pair\n",
+           vergenceN ? sqrt(vergenceErr/vergenceN) : 0., vergenceN, n, vergenceMs/n);
+    printf("SGBM:     RMS error %.1fcm over %d/%d pairs, %.2fms per pair\n",
+           sgbmN ? sqrt(sgbmErr/sgbmN) : 0., sgbmN, n, sgbmMs/n);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#ifndef OWLDEPTH_H
+#define OWLDEPTH_H
+
+/* Region distance estimation for the OWL stereo pair
+ *
+ * Reads the raw StereoSGBM output (CV_16S, disparity in 1/16 pixel units) over a window
+ * or a target mask and returns one robust distance for the whole region.
+ * A single pass builds a whole-pixel disparity histogram that also keeps the sum of the
+ * fine 1/16 pixel values per bin. The peak bin and its two neighbours are the inliers;
+ * everything else (holes, speckles, background behind the target) is rejected.
+ * The sub-pixel disparity is the mean of the inlier 1/16 pixel values.
+ */
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+using namespace std;
+using namespace cv;
+
+struct OwlRange {
+    float Distance;    // same units as the focal*baseline constant, <0 if no valid disparity
+    float Disparity;   // sub-pixel disparity in pixels
+    float Confidence;  // fraction of region pixels that voted for the peak (0..1)
+    int   Valid;       // number of pixels with a valid disparity
+};
+
+//Given a raw SGBM disparity map, this function returns a robust distance to the region roi
+//mask is optional (CV_8U, same size as roi or disp), only non-zero pixels are used
+//fb is the focal length * baseline constant for a 1/16 pixel disparity (distance = fb/disp16)
+inline OwlRange Owl_regionDistance(const Mat &disp, Rect roi, float fb, int numberOfDisparities, const Mat &mask = Mat()){
+
+    OwlRange range = {-1.f, 0.f, 0.f, 0};
+    CV_Assert(disp.type() == CV_16SC1);
+    Rect clipped = roi & Rect(0, 0, disp.cols, disp.rows);
+    if (clipped.area() == 0){
+        return range;
+    }
+
+    Mat region = disp(clipped);
+    Mat regionMask;
+    if (!mask.empty()){
+        CV_Assert(mask.type() == CV_8UC1);
+        if (mask.size() == disp.size()){
+            regionMask = mask(clipped);
+        }
+        else{
+            //a roi sized mask loses the same border as the roi
+            CV_Assert(mask.size() == roi.size());
+            regionMask = mask(clipped - roi.tl());
+        }
+    }
+
+    //Histogram of whole pixel disparities, plus the sum of the 1/16 pixel values in each bin
+    int bins = numberOfDisparities + 1;
+    int maxDisp16 = numberOfDisparities*16;
+    vector<int> hist(bins, 0);
+    vector<int64> fine(bins, 0);
+    int total = 0;
+
+    for (int i = 0; i < region.rows; i++){
+        const short *d = region.ptr<short>(i);
+        const uchar *m = regionMask.empty() ? 0 : regionMask.ptr<uchar>(i);
+        for (int j = 0; j < region.cols; j++){
+            if (m && !m[j]) continue;
+            total++;
+            int v = d[j];
+            if (v <= 0 || v > maxDisp16) continue; //SGBM marks invalid pixels with (minDisparity-1)*16
+            int b = v >> 4;
+            hist[b]++;
+            fine[b] += v;
+        }
+    }
+
+    //Peak of the histogram smoothed over three bins, so a peak split across two bins still wins
+    int peak = -1, best = 0, valid = hist[0];
+    for (int b = 1; b < bins; b++){
+        valid += hist[b];
+        int votes = hist[b-1] + hist[b] + (b+1 < bins ? hist[b+1] : 0);
+        if (votes > best){
+            best = votes;
+            peak = b;
+        }
+    }
+    range.Valid = valid;
+    if (peak < 0){
+        return range;
+    }
+
+    //Sub-pixel disparity from the mean of the inlier fine values
+    int lo = peak - 1, hi = min(peak + 1, bins - 1);
+    int64 sum = 0;
+    int count = 0;
+    for (int b = lo; b <= hi; b++){
+        sum += fine[b];
+        count += hist[b];
+    }
+    double disp16 = (double)sum/count;
+
+    range.Disparity = (float)(disp16/16.0);
+    range.Distance = (float)(fb/disp16);
+    range.Confidence = total > 0 ? (float)count/total : 0.f;
+    return range;
+}
+
+#endif // OWLDEPTH_H
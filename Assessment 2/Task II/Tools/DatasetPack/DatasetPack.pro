@@ -0,0 +1,17 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+INCLUDEPATH += C:\openCV343\release\install\include
+INCLUDEPATH += ../../../Common
+
+LIBS+= C:\openCV343\release\bin\libopencv_core343.dll
+LIBS+= C:\openCV343\release\bin\libopencv_imgcodecs343.dll
+
+SOURCES += \
+    dataset_pack.cpp
+
+HEADERS += \
+    ../../../Common/owl-mmap.h \
+    ../../../Common/owl-dataset.h
@@ -4,6 +4,7 @@ CONFIG -= app_bundle
 CONFIG -= qt
 
 INCLUDEPATH += C:\openCV343\release\install\include
+INCLUDEPATH += ../../../Common
 
 LIBS+= C:\openCV343\release\bin\libopencv_core343.dll
 LIBS+= C:\openCV343\release\bin\libopencv_highgui343.dll
@@ -17,5 +18,9 @@ LIBS +=-lws2_32 \
 SOURCES += \
     stereo_calib.cpp
 
+HEADERS += \
+    ../../../Common/owl-mmap.h \
+    ../../../Common/owl-calibration.h
+
 DISTFILES += \
     ../../Data/stereo_calib.xml
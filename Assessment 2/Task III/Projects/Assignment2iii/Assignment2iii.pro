@@ -4,6 +4,7 @@ CONFIG -= app_bundle
 CONFIG -= qt
 
 INCLUDEPATH += C:\openCV343\release\install\include
+INCLUDEPATH += ../../../Common
 
 LIBS+= C:\openCV343\release\bin\libopencv_core343.dll
 LIBS+= C:\openCV343\release\bin\libopencv_highgui343.dll
@@ -21,4 +22,14 @@ SOURCES += \
 HEADERS += \
     owl-comms.h \
     owl-pwm.h \
-    owl-cv.h
+    owl-cv.h \
+    owl-features.h \
+    owl-featuremaps.h \
+    owl-saliency.h \
+    owl-saccade.h \
+    owl-peaks.h \
+    owl-range.h \
+    ../../../Common/owl-mmap.h \
+    ../../../Common/owl-dataset.h \
+    ../../../Common/owl-calibration.h \
+    ../../../Common/owl-vergence.h
@@ -22,6 +22,8 @@ Use this code as a base for your assignment.
 #include <fstream>
 #include <math.h>
 #include <string>
+#include <sstream>
+#include <map>
 
 #include <sys/types.h>
 #ifndef _WIN32
@@ -30,6 +32,13 @@ Use this code as a base for your assignment.
 #include "owl-pwm.h"
 #include "owl-comms.h"
 #include "owl-cv.h"
+#include "owl-dataset.h"
+#include "owl-features.h"
+#include "owl-saliency.h"
+#include "owl-saccade.h"
+#include "owl-peaks.h"
+#include "owl-range.h"
+#include "owl-vergence.h"
 
 #include "opencv2/calib3d.hpp"
 
@@ -46,7 +55,18 @@ using namespace std;
 using namespace cv;
 
 Mat DoGFilter(Mat src, int k, int g);
-Mat StrongColour(Mat src);
+Mat LoadSample(OwlDataset &dataset, int sample);
+void CheckDoG(OwlDataset &dataset);
+void CheckFixed(OwlDataset &dataset, int steps);
+void CheckFovea(OwlDataset &dataset, int steps);
+Mat HeatMapPalette();
+SaliencyParams CurrentParams();
+void OnControlChange(int, void *engine);
+void Headless(const Mat &img, int steps, const String &disable, int scanpath);
+void DisableMaps(SaliencyEngine &engine, const String &names);
+void ShowMaps(SaliencyEngine &engine);
+void HeatMap(const Mat &salience, const Mat &palette, Mat &dst, int decimate);
+void Live(const String &source, const String &owl, const String &disable, const String &calibration, const String &vergencePath);
 
 //Default feature map weights
 static int ColourWeight    = 60 ; //Saturation and Brightness
@@ -54,124 +74,141 @@ static int DoGHighWeight    = 60 ; //Groups of edges in a small area
 static int DoGLowWeight     = 30 ; //DoG edge detection
 static int FamiliarWeight = 5  ; //Familiarity of the target, how much has the owl focused on this before
 static int foveaWeight    = 50 ; //Distance from fovea (center)
+static int IttiKochWeight = 0  ; //Itti & Koch centre-surround conspicuity, off unless -ittikoch is given
 static int CannyLowThreshold = 200;
 static int CannyHighThreshold = 300;
 
 static int Sample = 3;
-String ImagePath = "../../Data/Task 3 Salient Targets/Sample3.jpg";
+static int HeatMapDecimate = 1; //render the heat map at 1/HeatMapDecimate resolution, set with -heatdecimate
+static int ScanpathRadius = 60; //pixels around a planned target that the next targets keep clear of
+static int SaccadeDeadband = 10; //live mode: pixels from the centre within which the target is already fixated
+static int MotionSettleFrames = 5; //live mode: settled frames the motion background is built over before motion counts
+String DataPath = "../../Data/Task 3 Salient Targets/";
+String DatasetPath = "../../Data/salient.owlpack";
 
 int main(int argc, char *argv[])
 {
+    CommandLineParser parser(argc, argv, "{checkdog||compare the pyramid DoG with DoGFilter on every sample}"
+                                         "{checkfixed||compare the fixed point combine with the float one on every sample}"
+                                         "{checkfovea||compare the scanpaths of the fovea kernel and the per step fovea blur on every sample}"
+                                         "{headless||run without any windows and print the timings}"
+                                         "{steps|100|saccade steps to run in headless mode}"
+                                         "{disable||comma separated feature maps to leave out, e.g. Fovea,Canny}"
+                                         "{scanpath|1|targets planned from each saliency computation}"
+                                         "{heatdecimate|1|render the heat map at 1/N resolution}"
+                                         "{ittikoch|0|weight of the Itti & Koch map in every mode, 0 leaves it out}"
+                                         "{live||run on the stereo stream and drive the eyes to the most salient point}"
+                                         "{source|http://10.0.0.10:8080/stream/video.mjpeg|video stream for live mode}"
+                                         "{owl|10.0.0.10|address of the servo server for live mode}"
+                                         "{deadband|10|pixels from the centre within which live mode does not saccade}"
+                                         "{settleframes|5|frames after each saccade the motion background is built over in live mode}"
+                                         "{calibration|../../../Task II/Data/calibration.owlcal|stereo calibration bundle for the range to each target in live mode}"
+                                         "{vergence|../../../Task II/Data/vergence.xml|vergence model from Assignment2ii -vergence for the range from the eye positions in live mode}"
+                                         "{help||}");
+    if(parser.has("help")){
+        parser.printMessage();
+        return 0;
+    }
+
+    IttiKochWeight = parser.get<int>("ittikoch");
+
     //==========================================Initialize Variables=================================
-    Mat Left = imread(ImagePath);
+    //Use the decoded image store if it has been built with the DatasetPack tool, otherwise decode the jpg
+    OwlDataset dataset;
+    dataset.open(DatasetPath);
+
+    if(parser.has("checkdog")){
+        CheckDoG(dataset);
+        return 0;
+    }
+    if(parser.has("checkfixed")){
+        CheckFixed(dataset, 20);
+        return 0;
+    }
+    if(parser.has("checkfovea")){
+        CheckFovea(dataset, 20);
+        return 0;
+    }
+    if(parser.has("live")){
+        SaccadeDeadband = max(parser.get<int>("deadband"), 0);
+        MotionSettleFrames = max(parser.get<int>("settleframes"), 0);
+        Live(parser.get<String>("source"), parser.get<String>("owl"), parser.get<String>("disable"), parser.get<String>("calibration"),
+             parser.get<String>("vergence"));
+        return 0;
+    }
+
+    Mat Left = LoadSample(dataset, Sample);
+    if(parser.has("headless")){
+        Headless(Left, parser.get<int>("steps"), parser.get<String>("disable"), parser.get<int>("scanpath"));
+        return 0;
+    }
+    int Scanpath = max(parser.get<int>("scanpath"), 1);
+    HeatMapDecimate = max(parser.get<int>("heatdecimate"), 1);
+    SaliencePeaks peaks;
     Mat LeftDisplay;
     Left.copyTo(LeftDisplay);
-    Mat LeftGrey;
-    cvtColor(Left, LeftGrey, COLOR_BGR2GRAY);
-    Mat familiar(Left.size(),CV_8U,Scalar(255));
     Point Gaze(Left.size().width/2,Left.size().height/2);
 
+    SaliencyEngine engine;
+    DisableMaps(engine, parser.get<String>("disable"));
+    engine.setParams(CurrentParams());
+    engine.setImage(Left);
+
+    //=========================================Control Window for feature weights =============================================
+    //Created once, a moved trackbar hands the new weights to the engine, which marks the maps it affects dirty
+    namedWindow("Control", WINDOW_AUTOSIZE);
+    createTrackbar("LowFreq"  , "Control", &DoGLowWeight  , 100, OnControlChange, &engine);
+    createTrackbar("FamiliarW", "Control", &FamiliarWeight, 100, OnControlChange, &engine);
+    createTrackbar("foveaW"   , "Control", &foveaWeight   , 100, OnControlChange, &engine);
+
+    createTrackbar("CannyLowT", "Control", &CannyLowThreshold, 400, OnControlChange, &engine);
+    createTrackbar("CannyHighT", "Control", &CannyHighThreshold, 400, OnControlChange, &engine);
+    createTrackbar("IttiKochW", "Control", &IttiKochWeight, 100, OnControlChange, &engine);
+
     while (1){//Main processing loop
 
         // ======================================CALCULATE FEATURE MAPS ====================================
-        //============================================DoG low bandpass Map==================================
-        Mat DoGLow = DoGFilter(LeftGrey,3,51);
-        Mat DoGLow8;
-        normalize(DoGLow, DoGLow8, 0, 255, CV_MINMAX, CV_8U);
-        imshow("DoG Low", DoGLow8);
-
-        //=================================================Fovea Map========================================
-        //Local Feature Map  - implements FOVEA as a bias to the saliency map to central targets, rather than peripheral targets
-        Mat fovea(Left.size(),CV_8U,Scalar(0));
-        circle(fovea, Gaze, 150, 255, -1);
-        cv::blur(fovea, fovea, Size(301,301));
-        fovea.convertTo(fovea, CV_32FC1);
-        fovea*=foveaWeight;
-
-        //=======================================Canny Edge Detection=======================================
-        Mat edges;
-        Canny(LeftGrey, edges, CannyLowThreshold, CannyHighThreshold);
-        imshow("Canny", edges);
-
-        //=========================================Strong Colour Map=========================================
-        Mat colourMap = StrongColour(Left);
-        imshow("Strong Colour Map", colourMap);
-
-        //====================================Combine maps into saliency map================================
-        //Convert 8-bit Mat to 32bit floating point
-        DoGLow.convertTo(DoGLow, CV_32FC1);
-        DoGLow*=DoGLowWeight;
-        Mat familiarFloat;
-        familiar.convertTo(familiarFloat, CV_32FC1);
-
-        edges.convertTo(edges, CV_32FC1);
-        edges*=DoGHighWeight;
-        colourMap.convertTo(colourMap, CV_32FC1);
-        colourMap *= ColourWeight;
-
-        // Linear combination of feature maps to create a salience map
-        Mat Salience=cv::Mat(Left.size(),CV_32FC1,0.0); // init map
-        add(Salience,DoGLow,Salience);
-        add(Salience,fovea,Salience);
-
-        add(Salience,edges,Salience);
-        add(Salience,colourMap,Salience);
-
-        Salience=Salience.mul(familiarFloat);
-        normalize(Salience, Salience, 0, 255, CV_MINMAX, CV_32FC1);
-
-        //imshow("SalienceNew",Salience);
+        // Only the maps whose inputs changed are recomputed: the image maps once, the fovea when the gaze moves
+        engine.setGaze(Gaze);
+
         //=====================================Find & Move to Most Salient Target=========================================
-        double minVal; double maxVal; Point minLoc;
-        minMaxLoc(Salience, &minVal, &maxVal, &minLoc, &Gaze);
-
-        //Draw gaze path on screen
-        static Point GazeOld=Gaze;
-        line(LeftDisplay,Gaze,GazeOld,Scalar(0,255,255));
-        circle(LeftDisplay,GazeOld,5,Scalar(0,255,255),-1);
-        circle(LeftDisplay,Gaze,5,Scalar(0,0,255),-1);
-        GazeOld=Gaze;
-
-        // Update Familarity Map //
-        // Familiar map to inhibit salient targets once observed (this is a global map)
-        Mat familiarNew=familiar.clone();
-        circle(familiarNew, Gaze, 60, 0, -1);
-        cv::blur(familiarNew, familiarNew, Size(151,151)); //Blur used to save on processing
-        normalize(familiarNew, familiarNew, 0, 255, CV_MINMAX, CV_8U);
-        addWeighted(familiarNew, (static_cast<double>(FamiliarWeight)/100), familiar, (100-static_cast<double>(FamiliarWeight))/100, 0, familiar);
-        imshow("Familiar",familiar);
+        Gaze = engine.compute();
+        Mat Salience = engine.Salience;
+        //With -scanpath the next targets come from the same map instead of one recompute per saccade
+        vector<Point> Path(1, Gaze);
+        if(Scanpath > 1){
+            peaks.build(Salience);
+            Path = peaks.top(Scanpath, ScanpathRadius);
+        }
 
-        //=================================Convert Saliency into Heat Map=====================================
-        //this is just for visuals
-        Mat SalienceHSVnorm;
-        Salience.convertTo(Salience, CV_8UC1);
-        normalize(Salience, SalienceHSVnorm, 130, 255, CV_MINMAX, CV_8U);
-        normalize(Salience, Salience, 0, 255, CV_MINMAX, CV_8U);
-        Mat SalienceHSV;
-        cvtColor(Left, SalienceHSV, COLOR_BGR2HSV);
+        ShowMaps(engine);
 
-        for(int y=0;y<Left.size().height;y++){
-            for(int x=0; x<Left.size().width;x++){
-                SalienceHSV.at<Vec3b>(y,x)=Vec3b(255-SalienceHSVnorm.at<uchar>(y,x),255,255);
-            }
+        for(size_t i=0; i<Path.size(); i++){
+            Gaze = Path[i];
+
+            //Draw gaze path on screen
+            static Point GazeOld=Gaze;
+            line(LeftDisplay,Gaze,GazeOld,Scalar(0,255,255));
+            circle(LeftDisplay,GazeOld,5,Scalar(0,255,255),-1);
+            circle(LeftDisplay,Gaze,5,Scalar(0,0,255),-1);
+            GazeOld=Gaze;
+
+            // Update Familarity Map //
+            engine.attend(Gaze);
         }
-        cvtColor(SalienceHSV, SalienceHSV, COLOR_HSV2BGR);
+        imshow("Familiar",engine.Familiar);
+
+        //=================================Convert Saliency into Heat Map=====================================
+        //this is just for visuals, the salience is already normalised to 0..255
+        static Mat Palette = HeatMapPalette();
+        Mat SalienceHSV;
+        HeatMap(Salience, Palette, SalienceHSV, HeatMapDecimate);
 
 
         //=======================================Update Global View===========================================
         imshow("LeftDisplay",LeftDisplay);
         imshow("SalienceHSV",SalienceHSV);
 
-        //=========================================Control Window for feature weights =============================================
-        //cout<<"Control Window"<<endl;
-        namedWindow("Control", CV_WINDOW_AUTOSIZE);
-        cvCreateTrackbar("LowFreq"  , "Control", &DoGLowWeight  , 100);
-        cvCreateTrackbar("FamiliarW", "Control", &FamiliarWeight, 100);
-        cvCreateTrackbar("foveaW"   , "Control", &foveaWeight   , 100);
-
-        cvCreateTrackbar("CannyLowT", "Control", &CannyLowThreshold, 400);
-        cvCreateTrackbar("CannyHighT", "Control", &CannyHighThreshold, 400);
-
         waitKey(10);
     }
 }
@@ -189,40 +226,419 @@ Mat DoGFilter(Mat src, int k, int g){
 
 }
 
-Mat StrongColour(Mat src) {
-    //Convert to an HSV image
-    Mat src2;
-    cvtColor(src, src2, CV_BGR2HSV);
-
-    //Split HSV channels into Hue, Saturation, and Value images
-    Mat hsv[3];
-    split(src2,hsv);
-
-    //Convert Saturation and Value images to fit bigger values
-    Mat s,v;
-    hsv[1].convertTo(s,CV_32FC1);
-    hsv[2].convertTo(v,CV_32FC1);
-
-    //Multiply Saturation and Value to get intensity
-    Mat dst = s.mul(v);
-
-    //Fits value into specified range
-    normalize(dst, dst, 0, 255, CV_MINMAX, CV_8U);
-    return dst;
+//Load a sample image from the dataset store, or decode it if the store is missing
+Mat LoadSample(OwlDataset &dataset, int sample){
+    String SampleName = "Sample"+to_string(sample);
+    Mat img;
+    if(dataset.isOpened()){
+        img = dataset.frame(SampleName);
+    }
+    if(img.empty()){
+        img = imread(DataPath+SampleName+".jpg");
+    }
+    return img;
 }
 
+//Compare the pyramid DoG against the full resolution DoGFilter on Sample1..4
+void CheckDoG(OwlDataset &dataset){
+    for(int sample=1; sample<=4; sample++){
+        Mat img = LoadSample(dataset, sample);
+        if(img.empty()){
+            cout<<"Sample"<<sample<<" not found"<<endl;
+            continue;
+        }
+        Mat grey;
+        cvtColor(img, grey, COLOR_BGR2GRAY);
+
+        int64 t = getTickCount();
+        Mat ref = DoGFilter(grey,3,51);
+        double refMs = (getTickCount()-t)*1000./getTickFrequency();
+        t = getTickCount();
+        Mat pyr = DoGPyramid(grey,3,51);
+        double pyrMs = (getTickCount()-t)*1000./getTickFrequency();
+
+        double minVal, maxVal, maxErr;
+        minMaxLoc(ref, &minVal, &maxVal);
+        Mat err = abs(ref - pyr);
+        minMaxLoc(err, 0, &maxErr);
+        double range = maxVal - minVal;
+        cout<<"Sample"<<sample<<" "<<grey.cols<<"x"<<grey.rows<<": DoGFilter "<<refMs<<"ms, DoGPyramid "<<pyrMs<<"ms, "
+            <<"max error "<<100*maxErr/range<<"%, mean error "<<100*mean(err)[0]/range<<"% of the DoG range"<<endl;
+    }
+}
 
+//Run the saccade sequence of Sample1..4 with the float combine and, on the same maps and familiarity,
+//the fixed point combine. Reports how often the gaze agrees, how far the fixed point gaze is from the
+//float one and how salient it is in the float map (255 = the float maximum), and both combine times.
+void CheckFixed(OwlDataset &dataset, int steps){
+    for(int sample=1; sample<=4; sample++){
+        Mat img = LoadSample(dataset, sample);
+        if(img.empty()){
+            cout<<"Sample"<<sample<<" not found"<<endl;
+            continue;
+        }
+        SaliencyEngine engine;
+        engine.setParams(CurrentParams());
+        engine.setImage(img);
+        Point Gaze(img.cols/2, img.rows/2);
+
+        int same = 0;
+        double floatMs = 0, fixedMs = 0, distSum = 0, distMax = 0, salMin = 255;
+        for(int step=0; step<steps; step++){
+            engine.setGaze(Gaze);
+            engine.FixedPoint = false;
+            Point floatGaze = engine.compute(false);
+            floatMs += engine.CombineMs;
+            engine.FixedPoint = true;
+            Point fixedGaze = engine.compute(false);
+            fixedMs += engine.CombineMs;
+
+            //float map for the salience at the fixed point gaze
+            engine.FixedPoint = false;
+            engine.compute(true);
+            double dist = norm(floatGaze - fixedGaze);
+            same += dist == 0;
+            distSum += dist;
+            distMax = max(distMax, dist);
+            salMin = min(salMin, (double)engine.Salience.at<float>(fixedGaze));
+
+            engine.attend(floatGaze);
+            Gaze = floatGaze;
+        }
+        cout<<"Sample"<<sample<<" "<<img.cols<<"x"<<img.rows<<": "<<same<<"/"<<steps<<" gazes identical, "
+            <<"mean distance "<<distSum/steps<<"px, max "<<distMax<<"px, lowest float salience at the fixed gaze "<<salMin<<", "
+            <<"combine float "<<floatMs/steps<<"ms, fixed "<<fixedMs/steps<<"ms"<<endl;
+    }
+}
 
+//The fovea map as it was before the precomputed kernel: the circle drawn at the gaze and
+//box blurred every step with the default reflected border. Only used by CheckFovea
+class FoveaBlurMap : public FeatureMap {
+public:
+    FoveaBlurMap() : FeatureMap("Fovea Blur", FEATURE_GAZE, 1, 50){}
+    void compute(const FeatureInputs &in, Mat &out){
+        Mat fovea(in.Bgr.size(), CV_8U, Scalar(0));
+        circle(fovea, in.Gaze, 150, 255, -1);
+        cv::blur(fovea, fovea, Size(301,301));
+        fovea.convertTo(out, CV_32FC1);
+    }
+    void setParams(const SaliencyParams &p){ Weight = p.foveaWeight; }
+};
+
+//Run the saccade loop with the fovea kernel and with the per step blur side by side on Sample1..4
+//Each engine follows its own gaze, so a difference shows as the step where the scanpaths part
+void CheckFovea(OwlDataset &dataset, int steps){
+    for(int sample=1; sample<=4; sample++){
+        Mat img = LoadSample(dataset, sample);
+        if(img.empty()){
+            cout<<"Sample"<<sample<<" not found"<<endl;
+            continue;
+        }
+        SaliencyEngine kernel, blurred;
+        blurred.map("Fovea")->Enabled = false;
+        blurred.add(makePtr<FoveaBlurMap>());
+        kernel.setParams(CurrentParams());
+        blurred.setParams(CurrentParams());
+        kernel.setImage(img);
+        blurred.setImage(img);
+        Point kernelGaze(img.cols/2, img.rows/2), blurGaze = kernelGaze;
+
+        int same = 0, firstDiff = -1;
+        double distSum = 0, distMax = 0;
+        for(int step=0; step<steps; step++){
+            kernel.setGaze(kernelGaze);
+            blurred.setGaze(blurGaze);
+            kernelGaze = kernel.compute(false);
+            blurGaze = blurred.compute(false);
+            kernel.attend(kernelGaze);
+            blurred.attend(blurGaze);
+
+            double dist = norm(kernelGaze - blurGaze);
+            same += dist == 0;
+            if(dist > 0 && firstDiff < 0){
+                firstDiff = step;
+            }
+            distSum += dist;
+            distMax = max(distMax, dist);
+        }
+        cout<<"Sample"<<sample<<" "<<img.cols<<"x"<<img.rows<<": "<<same<<"/"<<steps<<" gazes identical, ";
+        if(firstDiff >= 0){
+            cout<<"first difference at step "<<firstDiff<<", ";
+        }
+        cout<<"mean distance "<<distSum/steps<<"px, max "<<distMax<<"px"<<endl;
+    }
+}
 
+//BGR colour of every 8 bit salience value, the hue 255-(130..255) the heat map used per pixel
+Mat HeatMapPalette(){
+    Mat hsv(1, 256, CV_8UC3);
+    for(int v=0; v<256; v++){
+        hsv.at<Vec3b>(0,v) = Vec3b(255-saturate_cast<uchar>(130+v*125/255.),255,255);
+    }
+    Mat palette;
+    cvtColor(hsv, palette, COLOR_HSV2BGR);
+    return palette;
+}
 
+//Heat map of a 0..255 salience map through the palette, decimate > 1 renders a smaller map
+void HeatMap(const Mat &salience, const Mat &palette, Mat &dst, int decimate){
+    Mat salience8, reduced;
+    salience.convertTo(salience8, CV_8U);
+    if(decimate > 1){
+        resize(salience8, reduced, Size(), 1./decimate, 1./decimate, INTER_NEAREST);
+    }
+    else{
+        reduced = salience8;
+    }
+    cvtColor(reduced, reduced, COLOR_GRAY2BGR);
+    LUT(reduced, palette, dst);
+}
 
+//Feature weights and thresholds as currently set on the control window
+SaliencyParams CurrentParams(){
+    SaliencyParams params = {ColourWeight, DoGHighWeight, DoGLowWeight, FamiliarWeight, foveaWeight, IttiKochWeight,
+                             CannyLowThreshold, CannyHighThreshold};
+    return params;
+}
 
+//Trackbar callback, the trackbar has already written the new value into its static
+void OnControlChange(int, void *engine){
+    ((SaliencyEngine*)engine)->setParams(CurrentParams());
+}
 
+//Run the saccade loop without HighGUI and print steps/sec and the time of every stage
+void Headless(const Mat &img, int steps, const String &disable, int scanpath){
+    if(img.empty() || steps <= 0){
+        cout<<"Nothing to run"<<endl;
+        return;
+    }
+    SaliencyEngine engine;
+    DisableMaps(engine, disable);
+    engine.setParams(CurrentParams());
+    engine.setImage(img);
+    Point Gaze(img.cols/2, img.rows/2);
+    SaliencePeaks peaks;
+
+    double computeMs = 0, combineMs = 0, attendMs = 0, peaksMs = 0, firstMapsMs = 0;
+    int saccades = 0;
+    int64 start = getTickCount();
+    for(int step=0; step<steps; step++){
+        engine.setGaze(Gaze);
+        int64 t = getTickCount();
+        //the peaks are read from Salience, so it is only kept when a scanpath is planned
+        Gaze = engine.compute(scanpath > 1);
+        computeMs += (getTickCount()-t)*1000./getTickFrequency();
+        combineMs += engine.CombineMs;
+        if(step == 0){
+            firstMapsMs = engine.MapsMs;
+        }
 
+        vector<Point> Path(1, Gaze);
+        if(scanpath > 1){
+            t = getTickCount();
+            peaks.build(engine.Salience);
+            Path = peaks.top(scanpath, ScanpathRadius);
+            peaksMs += (getTickCount()-t)*1000./getTickFrequency();
+        }
 
+        t = getTickCount();
+        for(size_t i=0; i<Path.size(); i++){
+            engine.attend(Path[i]);
+        }
+        attendMs += (getTickCount()-t)*1000./getTickFrequency();
+        Gaze = Path.back();
+        saccades += (int)Path.size();
+    }
+    double totalMs = (getTickCount()-start)*1000./getTickFrequency();
+
+    cout<<img.cols<<"x"<<img.rows<<", "<<steps<<" steps in "<<totalMs<<"ms, "<<steps*1000./totalMs<<" steps/sec"<<endl;
+    cout<<"  "<<saccades<<" saccades, "<<saccades*1000./totalMs<<" saccades/sec"<<endl;
+    cout<<"  Grey: "<<engine.GreyMs<<"ms"<<endl;
+    for(size_t i=0; i<engine.Maps.size(); i++){
+        const FeatureMap &map = *engine.Maps[i];
+        if(!map.Enabled){
+            cout<<"  "<<map.Name<<": disabled"<<endl;
+            continue;
+        }
+        if(map.Weight <= 0){
+            //not part of the model, time one compute so its cost is still reported
+            FeatureInputs in;
+            in.Bgr = img;
+            in.Grey = engine.Grey;
+            in.Gaze = Gaze;
+            Mat out;
+            int64 t = getTickCount();
+            engine.Maps[i]->compute(in, out);
+            cout<<"  "<<map.Name<<": weight 0, not in the model, one compute "<<(getTickCount()-t)*1000./getTickFrequency()<<"ms"<<endl;
+            continue;
+        }
+        cout<<"  "<<map.Name<<": weight "<<map.Weight<<", computed "<<map.Computed<<"x, last "<<map.Ms<<"ms, "
+            <<map.Bytes/1024<<"kB"<<endl;
+    }
+    cout<<"  feature maps on the first step: "<<firstMapsMs<<"ms wall time, the maps run concurrently after Grey"<<endl;
+    cout<<"  compute: "<<computeMs/steps<<"ms/step, of which combine "<<combineMs/steps<<"ms/step"<<endl;
+    if(scanpath > 1){
+        cout<<"  top "<<scanpath<<" peaks: "<<peaksMs/steps<<"ms/step"<<endl;
+    }
+    cout<<"  attend: "<<attendMs/steps<<"ms/step"<<endl;
+    cout<<"  last gaze "<<Gaze<<endl;
+}
 
+//Leave the named feature maps out of the engine
+void DisableMaps(SaliencyEngine &engine, const String &names){
+    stringstream list(names);
+    string name;
+    while(getline(list, name, ',')){
+        FeatureMap *map = engine.map(name);
+        if(map){
+            map->Enabled = false;
+        }
+        else if(!name.empty()){
+            cout<<"No feature map called "<<name<<endl;
+        }
+    }
+}
 
+//Show every image based feature map after it has been recomputed, float maps are normalised for display
+void ShowMaps(SaliencyEngine &engine){
+    static map<string,int> shown;
+    for(size_t i=0; i<engine.Maps.size(); i++){
+        const FeatureMap &m = *engine.Maps[i];
+        if(!m.Enabled || m.Input == FEATURE_GAZE || shown[m.Name] == m.Computed){
+            continue;
+        }
+        shown[m.Name] = m.Computed;
+        if(m.Map.type() == CV_8UC1){
+            imshow(m.Name, m.Map);
+        }
+        else{
+            Mat display;
+            normalize(m.Map, display, 0, 255, NORM_MINMAX, CV_8U);
+            imshow(m.Name, display);
+        }
+    }
+}
 
+//Saccade to the most salient point of the left eye, frame by frame from the stream
+//The servo commands go through a mailbox thread, so the vision loop runs at the camera rate.
+//Familiarity is kept in servo angle coordinates: the world is every pixel the left eye can
+//bring to its centre, and the frame sits in it at the eye's last commanded position
+void Live(const String &source, const String &owl, const String &disable, const String &calibration, const String &vergencePath){
+    //Setup TCP coms
+    int PORT=12345;
+    SOCKET u_sock = OwlCommsInit(PORT, owl);
+
+    //Set servo positions to their center-points
+    Rx = RxC; Lx = LxC;
+    Ry = RyC; Ly = LyC;
+    Neck= NeckC;
+    OwlServoMailbox servos;
+    servos.start(u_sock);
+    servos.post(Rx, Ry, Lx, Ly, Neck);
+
+    VideoCapture cap(source);
+    if(!cap.isOpened()){
+        cout<<"Could not open the input video: "<<source<<endl;
+        return;
+    }
 
+    const double pwmPerPx = PX2DEG*DEG2PWM;
+    SaliencyEngine engine;
+    DisableMaps(engine, disable);
+    engine.setParams(CurrentParams());
+    engine.setWorld(Size(640 + cvCeil((LxRm-LxLm)/pwmPerPx), 480 + cvCeil((LyBm-LyTm)/pwmPerPx)));
+    //Moving objects only make sense on a live feed, so the motion map is only registered here
+    Ptr<MotionMap> motion = makePtr<MotionMap>();
+    motion->SettleFrames = MotionSettleFrames;
+    engine.add(motion);
+    const double SettleTime = 0.1; //seconds after an acknowledged saccade before motion counts again
+
+    //Range to every target from the stereo pair, matched around the target only
+    OwlStereoRange stereo;
+    if(!stereo.open(calibration)){
+        cout<<"No calibration bundle at "<<calibration<<", running without range"<<endl;
+    }
+    OwlGazeRange range = {-1.f, 0.f, 0.f, 0.f};
 
+    //Range from the eye positions once the right eye has been turned onto the target of the left
+    OwlVergence vergence(IPD, DEG2PWM, LxC, RxC);
+    bool verging = vergence.load(vergencePath);
+    if(!verging){
+        cout<<"No vergence model at "<<vergencePath<<", the eyes move together"<<endl;
+    }
+    double vergenceRange = -1;
+
+    Mat Frame, FrameFlpd;
+    int frames = 0, saccades = 0;
+    int64 start = getTickCount();
+    while(cap.read(Frame)){
+        //flip input image as it comes in reversed, the left eye drives the saliency
+        flip(Frame,FrameFlpd,1);
+        Mat Left = FrameFlpd(Rect(0, 0, 640, 480));
+        Mat Right = FrameFlpd(Rect(640, 0, 640, 480));
+        Point centre(Left.cols/2, Left.rows/2);
+
+        engine.setImage(Left);
+        engine.setOrigin(Point(cvRound((Lx-LxLm)/pwmPerPx), cvRound((Ly-LyTm)/pwmPerPx)));
+        engine.setGaze(centre);
+        bool moving = !servos.idle() || (getTickCount()-servos.lastSent())/getTickFrequency() < SettleTime;
+        motion->setMoving(moving);
+        Point Target = engine.compute(false);
+
+        //Only start a saccade once the last one has been acknowledged and the eyes have settled
+        if(!moving){
+            engine.attend(Target);
+            if(stereo.isOpened()){
+                range = stereo.measure(Left, Right, Target);
+            }
+            //A target inside the dead-band is already fixated, leave the eyes and the motion background alone
+            if(abs(Target.x-centre.x) > SaccadeDeadband || abs(Target.y-centre.y) > SaccadeDeadband){
+                int dx = cvRound((Target.x-centre.x)*pwmPerPx), dy = cvRound((Target.y-centre.y)*pwmPerPx);
+                Rx = min(max(Rx+dx, RxLm), RxRm);
+                Lx = min(max(Lx+dx, LxLm), LxRm);
+                Ry = min(max(Ry-dy, RyBm), RyTm); //right eye PWM grows upwards
+                Ly = min(max(Ly+dy, LyTm), LyBm); //left eye PWM grows downwards
+                servos.post(Rx, Ry, Lx, Ly, Neck);
+                saccades++;
+                vergenceRange = -1;
+            }
+            else if(verging){
+                //Fixated, turn the right eye onto the window the left eye is centred on
+                float score;
+                Point2f offset = Owl_fixationOffset(Left, Right, Rect(centre.x-32, centre.y-32, 64, 64), 200, &score);
+                int dx = cvRound(offset.x*pwmPerPx);
+                if(score > 0.5f && dx != 0){
+                    Rx = min(max(Rx+dx, RxLm), RxRm);
+                    servos.post(Rx, Ry, Lx, Ly, Neck);
+                }
+                else if(score > 0.5f){
+                    vergenceRange = vergence.distance(Lx, Rx);
+                }
+            }
+        }
 
+        circle(Left, centre, 10, Scalar(255,255,255), 1);
+        circle(Left, Target, 5, Scalar(0,0,255), -1);
+        if(range.Distance > 0){
+            putText(Left, format("%.1f (%.2f)", range.Distance, range.Confidence), Target + Point(8, -8),
+                    FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0,0,255));
+        }
+        imshow("Live", Left);
+
+        if(++frames % 30 == 0){
+            double secs = (getTickCount()-start)/getTickFrequency();
+            cout<<frames/secs<<" fps, "<<saccades<<" saccades, last map time "<<engine.MapsMs<<"ms + combine "<<engine.CombineMs<<"ms"<<endl;
+            if(stereo.isOpened()){
+                cout<<"  last target range "<<range.Distance<<" (disparity "<<range.Disparity<<"px, confidence "
+                    <<range.Confidence<<") in "<<range.Ms<<"ms"<<endl;
+            }
+            if(verging){
+                cout<<"  last vergence range "<<vergenceRange<<" (Lx-LxC "<<Lx-LxC<<", Rx-RxC "<<Rx-RxC<<")"<<endl;
+            }
+        }
+        if(waitKey(1) == 27){
+            break;
+        }
+    }
+    servos.close();
+}
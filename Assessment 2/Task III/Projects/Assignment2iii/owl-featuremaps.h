@@ -0,0 +1,181 @@
+#ifndef OWLFEATUREMAPS_H
+#define OWLFEATUREMAPS_H
+
+/* Feature map interface for the saliency engine
+ * (c) Plymouth University
+ *
+ * A feature map declares the input it is computed from, the resolution of its output and
+ * its weight. The engine decides when it has to be recomputed, runs it, brings the output
+ * to image resolution (and to 8 bit for the fixed point combine) and adds it into the
+ * salience map. To add a map, derive from FeatureMap, implement compute() and register it
+ * with SaliencyEngine::add().
+ */
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "owl-features.h"
+
+using namespace std;
+using namespace cv;
+
+struct SaliencyParams {
+    int ColourWeight, DoGHighWeight, DoGLowWeight, FamiliarWeight, foveaWeight, IttiKochWeight;
+    int CannyLowThreshold, CannyHighThreshold;
+};
+
+// What a feature map is computed from, a map goes dirty when its input changes
+enum FeatureInput {
+    FEATURE_BGR,    // the colour image
+    FEATURE_GREY,   // the grey image, converted once by the engine and shared
+    FEATURE_GAZE    // the image size and the current gaze
+};
+
+struct FeatureInputs {
+    Mat Bgr, Grey;
+    Point Gaze;
+};
+
+class FeatureMap {
+public:
+    FeatureMap(const string &name, int input, int scale, int weight)
+        : Name(name), Input(input), Scale(scale), Weight(weight), Enabled(true),
+          Dirty(true), Ms(0), Computed(0), Bytes(0){}
+    virtual ~FeatureMap(){}
+
+    //Output at 1/Scale of the image size, CV_8UC1 or CV_32FC1. Larger is more salient
+    virtual void compute(const FeatureInputs &in, Mat &out) = 0;
+    //Called with every parameter change, take the weight and mark the map Dirty if it uses a changed value
+    virtual void setParams(const SaliencyParams &){}
+    //Bytes the map keeps besides its output, e.g. a precomputed kernel
+    virtual size_t stateBytes() const { return 0; }
+
+    string Name;
+    int Input;       // FeatureInput
+    int Scale;       // output resolution is 1/Scale of the image, the engine upsamples it
+    int Weight;      // 0..100, weight in the salience sum
+    bool Enabled;
+
+    //Kept by the engine
+    bool Dirty;
+    Mat Map;         // last output of compute()
+    Mat Full, Full8; // Map at image resolution, and saturated to 8 bit for the fixed point combine
+    double Ms;       // time of the last compute including the conversions
+    int Computed;    // number of computes, for profiling
+    size_t Bytes;    // memory held by the outputs and stateBytes(), views into other maps are not counted
+};
+
+// DoG edge detection, low spatial frequencies
+class DoGLowMap : public FeatureMap {
+public:
+    DoGLowMap() : FeatureMap("DoG Low", FEATURE_GREY, 1, 30){}
+    void compute(const FeatureInputs &in, Mat &out){ out = DoGPyramid(in.Grey, 3, 51); }
+    void setParams(const SaliencyParams &p){ Weight = p.DoGLowWeight; }
+};
+
+// Groups of edges in a small area
+class CannyMap : public FeatureMap {
+public:
+    CannyMap() : FeatureMap("Canny", FEATURE_GREY, 1, 60), low(-1), high(-1){}
+    void compute(const FeatureInputs &in, Mat &out){ Canny(in.Grey, out, low, high); }
+    void setParams(const SaliencyParams &p){
+        Weight = p.DoGHighWeight;
+        if (p.CannyLowThreshold != low || p.CannyHighThreshold != high){
+            low = p.CannyLowThreshold;
+            high = p.CannyHighThreshold;
+            Dirty = true;
+        }
+    }
+
+private:
+    int low, high;
+};
+
+// Saturation and brightness
+class StrongColourMap : public FeatureMap {
+public:
+    StrongColourMap() : FeatureMap("Strong Colour", FEATURE_BGR, 1, 60){}
+    void compute(const FeatureInputs &in, Mat &out){ out = StrongColour(in.Bgr); }
+    void setParams(const SaliencyParams &p){ Weight = p.ColourWeight; }
+};
+
+//Local Feature Map  - implements FOVEA as a bias to the saliency map to central targets, rather than peripheral targets
+//The map is a window into the precomputed kernel, centred on the gaze
+class FoveaMap : public FeatureMap {
+public:
+    FoveaMap() : FeatureMap("Fovea", FEATURE_GAZE, 1, 50){}
+    void compute(const FeatureInputs &in, Mat &out){
+        Size size = in.Bgr.size();
+        if (kernel.rows != size.height*2 || kernel.cols != size.width*2){
+            kernel = FoveaKernel(size, 150, 301);
+        }
+        Point g(min(max(in.Gaze.x, 0), size.width-1), min(max(in.Gaze.y, 0), size.height-1));
+        out = kernel(Rect(size.width - g.x, size.height - g.y, size.width, size.height));
+    }
+    void setParams(const SaliencyParams &p){ Weight = p.foveaWeight; }
+    size_t stateBytes() const { return kernel.total()*kernel.elemSize(); }
+
+private:
+    Mat kernel;
+};
+
+// Itti & Koch centre-surround model, intensity, colour opponency and orientation on a Gaussian
+// pyramid. The conspicuity map is computed at pyramid level 4 and upsampled by the engine.
+// Registered with weight 0, so it is only computed once a weight is given
+class IttiKochMap : public FeatureMap {
+public:
+    IttiKochMap() : FeatureMap("Itti-Koch", FEATURE_BGR, 16, 0){}
+    void compute(const FeatureInputs &in, Mat &out){ out = IttiKoch(in.Bgr); }
+    void setParams(const SaliencyParams &p){ Weight = p.IttiKochWeight; }
+};
+
+// Motion: difference to a running background at 1/4 resolution. The buffers are reused, so
+// after the first frame a frame allocates nothing. While setMoving(true) the background is
+// rebased on every frame and the map stays empty, so the owl's own saccades are not seen as motion.
+// Once the eyes stop the background is the mean of the first SettleFrames frames before it is compared
+class MotionMap : public FeatureMap {
+public:
+    MotionMap() : FeatureMap("Motion", FEATURE_GREY, 4, 50), Rate(0.05), SettleFrames(5), moving(false), settled(0){}
+
+    void compute(const FeatureInputs &in, Mat &out){
+        Size size((in.Grey.cols + Scale - 1)/Scale, (in.Grey.rows + Scale - 1)/Scale);
+        resize(in.Grey, reduced, size, 0, 0, INTER_AREA);
+        reduced.convertTo(reducedF, CV_32F);
+        if (background.size() != size || moving){
+            reducedF.copyTo(background);
+            motion.create(size, CV_8U);
+            motion.setTo(0);
+            settled = 0;
+        }
+        else if (settled < SettleFrames){
+            //still building the background of the new view, the mean of the settled frames so far
+            accumulateWeighted(reducedF, background, 1./(settled + 1));
+            settled++;
+        }
+        else{
+            absdiff(reducedF, background, diff);
+            diff.convertTo(motion, CV_8U);
+            accumulateWeighted(reducedF, background, Rate);
+        }
+        out = motion;
+    }
+
+    //Commanded eye motion, set every frame before the engine computes
+    void setMoving(bool m){
+        moving = m;
+    }
+
+    size_t stateBytes() const {
+        return reduced.total()*reduced.elemSize() + (reducedF.total() + background.total() + diff.total())*sizeof(float);
+    }
+
+    double Rate;       // background learning rate per frame
+    int SettleFrames;  // frames after the eyes stop that only build the background, no motion is output
+
+private:
+    Mat reduced, reducedF, background, diff, motion;
+    bool moving;
+    int settled;
+};
+
+#endif // OWLFEATUREMAPS_H
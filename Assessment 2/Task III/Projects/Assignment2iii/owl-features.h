@@ -0,0 +1,175 @@
+#ifndef OWLFEATURES_H
+#define OWLFEATURES_H
+
+/* Feature map kernels for the OWL saliency model
+ * (c) Plymouth University
+ */
+#include <vector>
+#include <math.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+// DoG bandpass filter computed on a Gaussian pyramid, same (k, g) parameters as DoGFilter
+// Both blurs are done at the coarsest pyramid level where the narrower one still spans at
+// least 2 pixels, so the 51x51 / 153x153 kernels shrink to a few pixels. Only the difference
+// is upsampled back to full resolution.
+Mat DoGPyramid(Mat src, int k, int g){
+    //sigma that GaussianBlur derives from a kernel size of g and g*k
+    double s1 = 0.3*((g-1)*0.5 - 1) + 0.8;
+    double s2 = 0.3*((g*k-1)*0.5 - 1) + 0.8;
+
+    //each pyrDown adds a blur of 1 pixel sigma at its own level, (4^n-1)/3 variance in full resolution pixels
+    int levels = 0;
+    double pyrVar = 0;
+    for (;;){
+        int next = levels + 1;
+        double var = (pow(4.0, next) - 1)/3;
+        if (s1*s1 <= var || sqrt(s1*s1 - var)/(1 << next) < 2 || (min(src.rows, src.cols) >> next) < 16){
+            break;
+        }
+        levels = next;
+        pyrVar = var;
+    }
+
+    vector<Mat> pyr(levels + 1);
+    src.convertTo(pyr[0], CV_32FC1);
+    for (int i = 1; i <= levels; i++){
+        pyrDown(pyr[i-1], pyr[i]);
+    }
+
+    double scale = 1 << levels;
+    Mat g1, g2;
+    GaussianBlur(pyr[levels], g1, Size(), sqrt(s1*s1 - pyrVar)/scale);
+    GaussianBlur(pyr[levels], g2, Size(), sqrt(s2*s2 - pyrVar)/scale);
+    Mat dst = (g1 - g2)*2;
+
+    for (int i = levels; i > 0; i--){
+        pyrUp(dst, dst, pyr[i-1].size());
+    }
+    return dst;
+}
+
+// Strong colour map: saturation * value, normalised to 8 bit
+Mat StrongColour(Mat src) {
+    //Convert to an HSV image
+    Mat src2;
+    cvtColor(src, src2, COLOR_BGR2HSV);
+
+    //Split HSV channels into Hue, Saturation, and Value images
+    Mat hsv[3];
+    split(src2,hsv);
+
+    //Convert Saturation and Value images to fit bigger values
+    Mat s,v;
+    hsv[1].convertTo(s,CV_32FC1);
+    hsv[2].convertTo(v,CV_32FC1);
+
+    //Multiply Saturation and Value to get intensity
+    Mat dst = s.mul(v);
+
+    //Fits value into specified range
+    normalize(dst, dst, 0, 255, NORM_MINMAX, CV_8U);
+    return dst;
+}
+
+// Fovea bias kernel: a filled circle blurred by a box filter, drawn once at the centre of a
+// map twice the image size. The fovea map for any gaze inside the image is the size(image)
+// window of this kernel at (width - gaze.x, height - gaze.y), so no per-step blur is needed.
+// Returned as 8 bit, 0..255.
+Mat FoveaKernel(Size size, int radius, int box){
+    Mat kernel(size.height*2, size.width*2, CV_8U, Scalar(0));
+    circle(kernel, Point(size.width, size.height), radius, 255, -1);
+    cv::blur(kernel, kernel, Size(box,box), Point(-1,-1), BORDER_CONSTANT);
+    return kernel;
+}
+
+// Itti & Koch normalisation operator N(): scale to 0..1, then promote maps with a few strong
+// peaks over maps with many comparable ones by (1 - mean of the other local maxima)^2
+Mat IttiNormalise(const Mat &src){
+    double lo, hi;
+    minMaxLoc(src, &lo, &hi);
+    if (hi - lo < 1e-6){
+        return Mat::zeros(src.size(), CV_32FC1);
+    }
+    Mat m, peaks;
+    src.convertTo(m, CV_32FC1, 1/(hi - lo), -lo/(hi - lo));
+    dilate(m, peaks, Mat());
+    Mat mask = (m >= peaks) & (m > 0.05);
+    int count = countNonZero(mask);
+    double others = count > 1 ? (mean(m, mask)[0]*count - 1)/(count - 1) : 0;
+    return m*((1 - others)*(1 - others));
+}
+
+// Across scale centre-surround of a pyramid that starts at level 2: the sum over centres
+// c = 2, 3, 4 and surrounds s = c+3, c+4 of N(|P(c) - P(s)|), brought to level 4
+Mat CentreSurround(const vector<Mat> &pyr){
+    Size out = pyr[2].size();
+    Mat sum = Mat::zeros(out, CV_32FC1), surround, diff;
+    for (int c = 2; c <= 4; c++){
+        for (int s = c + 3; s <= c + 4; s++){
+            resize(pyr[s - 2], surround, pyr[c - 2].size(), 0, 0, INTER_LINEAR);
+            absdiff(pyr[c - 2], surround, diff);
+            diff = IttiNormalise(diff);
+            if (diff.size() != out){
+                resize(diff, diff, out, 0, 0, INTER_AREA);
+            }
+            sum += diff;
+        }
+    }
+    return sum;
+}
+
+// Itti & Koch saliency: 9 level Gaussian pyramids of intensity, red-green and blue-yellow
+// opponency and Gabor orientation at 0, 45, 90 and 135 degrees. Only levels 2..8 are used,
+// so the channels are computed once at level 2. Returns the saliency map at level 4
+// (1/16 of the image) scaled to roughly 0..255
+Mat IttiKoch(const Mat &bgr){
+    Mat level2, f;
+    pyrDown(bgr, level2);
+    pyrDown(level2, level2);
+    level2.convertTo(f, CV_32FC3, 1/255.);
+    Mat ch[3];
+    split(f, ch);
+    Mat I = (ch[0] + ch[1] + ch[2])/3;
+
+    //hue is only meaningful where there is enough light
+    double iMax;
+    minMaxLoc(I, 0, &iMax);
+    Mat dark = I <= iMax/10;
+    Mat b, g, r;
+    divide(ch[0], I, b);
+    divide(ch[1], I, g);
+    divide(ch[2], I, r);
+    b.setTo(0, dark);
+    g.setTo(0, dark);
+    r.setTo(0, dark);
+    Mat R = max(r - (g + b)/2, 0.), G = max(g - (r + b)/2, 0.);
+    Mat B = max(b - (r + g)/2, 0.), Y = max((r + g)/2 - abs(r - g)/2 - b, 0.);
+
+    vector<Mat> pI, pRG, pBY;
+    buildPyramid(I, pI, 6);
+    buildPyramid(R - G, pRG, 6);
+    buildPyramid(B - Y, pBY, 6);
+    Mat intensity = CentreSurround(pI);
+    Mat colour = CentreSurround(pRG) + CentreSurround(pBY);
+
+    Mat orientation = Mat::zeros(intensity.size(), CV_32FC1);
+    vector<Mat> pO(pI.size());
+    for (int a = 0; a < 4; a++){
+        Mat gabor = getGaborKernel(Size(9,9), 2.0, a*CV_PI/4, 5.0, 0.5, 0, CV_32F);
+        gabor -= mean(gabor)[0]; //no response to flat areas
+        for (size_t l = 0; l < pI.size(); l++){
+            filter2D(pI[l], pO[l], CV_32F, gabor);
+            pO[l] = abs(pO[l]);
+        }
+        orientation += IttiNormalise(CentreSurround(pO));
+    }
+
+    Mat saliency = (IttiNormalise(intensity) + IttiNormalise(colour) + IttiNormalise(orientation))*(255./3);
+    return saliency;
+}
+
+#endif // OWLFEATURES_H
@@ -0,0 +1,145 @@
+#ifndef OWLPEAKS_H
+#define OWLPEAKS_H
+
+/* Top-K peaks of a salience map
+ * (c) Plymouth University
+ *
+ * build() scans the map once into a max pyramid: level 0 holds the maximum (and where it is)
+ * of every Block x Block block, every level above the maximum of 2x2 cells below, up to a
+ * single root. The root is the next peak. Taking it suppresses a disc of pixels around it,
+ * which only rescans the blocks under the disc and updates their ancestors, so every
+ * further peak costs O(radius^2 + log(area)) instead of a scan of the whole map.
+ */
+#include <vector>
+#include <float.h>
+#include <opencv2/core/core.hpp>
+
+using namespace std;
+using namespace cv;
+
+class SaliencePeaks {
+public:
+    SaliencePeaks() : Block(8){}
+
+    //Index a CV_32FC1 salience map, the map must stay valid until the last top()
+    void build(const Mat &salience){
+        CV_Assert(salience.type() == CV_32FC1);
+        map = salience;
+        suppressed.create(map.size(), CV_8U);
+        suppressed.setTo(0);
+
+        vals.clear();
+        locs.clear();
+        Size cells((map.cols + Block - 1)/Block, (map.rows + Block - 1)/Block);
+        vals.push_back(Mat(cells, CV_32FC1));
+        locs.push_back(Mat(cells, CV_32SC2));
+        for (int by = 0; by < cells.height; by++){
+            for (int bx = 0; bx < cells.width; bx++){
+                blockMax(bx, by);
+            }
+        }
+        while (vals.back().total() > 1){
+            cells = Size((vals.back().cols + 1)/2, (vals.back().rows + 1)/2);
+            vals.push_back(Mat(cells, CV_32FC1));
+            locs.push_back(Mat(cells, CV_32SC2));
+            int l = (int)vals.size() - 1;
+            for (int y = 0; y < cells.height; y++){
+                for (int x = 0; x < cells.width; x++){
+                    parent(l, x, y);
+                }
+            }
+        }
+    }
+
+    //The k most salient points, each more than radius pixels from the ones before it,
+    //best first. Fewer if the map runs out. Their salience goes to values if given
+    vector<Point> top(int k, int radius, vector<float> *values = 0){
+        vector<Point> peaks;
+        for (int i = 0; i < k && !vals.empty(); i++){
+            float v = vals.back().at<float>(0, 0);
+            if (v == -FLT_MAX){
+                break;
+            }
+            Point p = locs.back().at<Point>(0, 0);
+            peaks.push_back(p);
+            if (values){
+                values->push_back(v);
+            }
+            suppress(p, radius);
+        }
+        return peaks;
+    }
+
+    int Block;  // level 0 block size in pixels
+
+private:
+    //Maximum of the unsuppressed pixels of a level 0 block, first in raster order on ties
+    void blockMax(int bx, int by){
+        float best = -FLT_MAX;
+        Point loc(bx*Block, by*Block);
+        int x1 = min((bx + 1)*Block, map.cols), y1 = min((by + 1)*Block, map.rows);
+        for (int y = by*Block; y < y1; y++){
+            const float *row = map.ptr<float>(y);
+            const uchar *off = suppressed.ptr<uchar>(y);
+            for (int x = bx*Block; x < x1; x++){
+                if (!off[x] && row[x] > best){
+                    best = row[x];
+                    loc = Point(x, y);
+                }
+            }
+        }
+        vals[0].at<float>(by, bx) = best;
+        locs[0].at<Point>(by, bx) = loc;
+    }
+
+    //Cell (x, y) of level l from its children in level l-1
+    void parent(int l, int x, int y){
+        const Mat &childVals = vals[l - 1], &childLocs = locs[l - 1];
+        float best = -FLT_MAX;
+        Point loc = childLocs.at<Point>(2*y, 2*x);
+        for (int cy = 2*y; cy < min(2*y + 2, childVals.rows); cy++){
+            for (int cx = 2*x; cx < min(2*x + 2, childVals.cols); cx++){
+                if (childVals.at<float>(cy, cx) > best){
+                    best = childVals.at<float>(cy, cx);
+                    loc = childLocs.at<Point>(cy, cx);
+                }
+            }
+        }
+        vals[l].at<float>(y, x) = best;
+        locs[l].at<Point>(y, x) = loc;
+    }
+
+    //Take the disc around p out of the map and update the blocks under it and their ancestors
+    void suppress(Point p, int radius){
+        Rect area = Rect(p.x - radius, p.y - radius, 2*radius + 1, 2*radius + 1) & Rect(0, 0, map.cols, map.rows);
+        for (int y = area.y; y < area.br().y; y++){
+            uchar *off = suppressed.ptr<uchar>(y);
+            for (int x = area.x; x < area.br().x; x++){
+                if ((x - p.x)*(x - p.x) + (y - p.y)*(y - p.y) <= radius*radius){
+                    off[x] = 1;
+                }
+            }
+        }
+
+        int x0 = area.x/Block, y0 = area.y/Block;
+        int x1 = (area.br().x - 1)/Block, y1 = (area.br().y - 1)/Block;
+        for (int by = y0; by <= y1; by++){
+            for (int bx = x0; bx <= x1; bx++){
+                blockMax(bx, by);
+            }
+        }
+        for (size_t l = 1; l < vals.size(); l++){
+            x0 /= 2; y0 /= 2; x1 /= 2; y1 /= 2;
+            for (int y = y0; y <= y1; y++){
+                for (int x = x0; x <= x1; x++){
+                    parent((int)l, x, y);
+                }
+            }
+        }
+    }
+
+    Mat map, suppressed;
+    vector<Mat> vals, locs;  // max pyramid, level 0 is per block
+};
+
+#endif // OWLPEAKS_H
@@ -0,0 +1,140 @@
+#ifndef OWLRANGE_H
+#define OWLRANGE_H
+
+/* Sparse stereo range to a single image point
+ * (c) Plymouth University
+ *
+ * Instead of rectifying both frames and running SGBM over the whole image, only the pixels
+ * the match needs are rectified: a Patch x Patch template around the point in the left eye
+ * and the strip of the same rows in the right eye that covers the disparity search range.
+ * Both come from the remap tables of the Task II calibration bundle, a sub rectangle of the
+ * tables remaps exactly that part of the rectified image. The template is matched along the
+ * strip with normalised cross correlation, the peak is refined with a parabola and the
+ * point is triangulated with Q.
+ *
+ * The calibration holds while the eyes keep the pose they were calibrated in, conjugate
+ * saccades move both eyes by the same angle, so the range is an approximation away from
+ * the centre.
+ */
+#include <vector>
+#include <string>
+#include <float.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+
+#include "owl-calibration.h"
+
+using namespace std;
+using namespace cv;
+
+struct OwlGazeRange {
+    float Distance;    // depth along the optical axis in the units of the calibration T, <0 if no match
+    float Disparity;   // sub-pixel disparity in rectified pixels
+    float Confidence;  // NCC of the match minus the best NCC more than 2 disparities away (0..1)
+    float Ms;          // time of the query
+};
+
+class OwlStereoRange {
+public:
+    OwlStereoRange() : Patch(15), MinDisparity(1), MaxDisparity(160), MinContrast(2.0){}
+
+    bool open(const string &bundlePath){
+        return calib.open(bundlePath);
+    }
+
+    bool isOpened() const { return calib.isOpened(); }
+
+    //Range to point in the raw (unrectified) left frame, left and right are raw frames
+    OwlGazeRange measure(const Mat &left, const Mat &right, Point point){
+        int64 t = getTickCount();
+        OwlGazeRange range = {-1.f, 0.f, 0.f, 0.f};
+        if (!calib.isOpened() || left.size() != calib.ImageSize || right.size() != calib.ImageSize){
+            return range;
+        }
+
+        //The point in the rectified left image
+        vector<Point2f> raw(1, Point2f((float)point.x, (float)point.y)), rect;
+        undistortPoints(raw, rect, calib.M1, calib.D1, calib.R1, calib.P1);
+        Point2f pr = rect[0];
+        int half = Patch/2, u = cvRound(pr.x), v = cvRound(pr.y);
+        Rect image(Point(0, 0), calib.ImageSize);
+        Rect patchRect(u - half, v - half, Patch, Patch);
+        int maxDisparity = min(MaxDisparity, u - half);
+        if ((patchRect & image) != patchRect || maxDisparity < MinDisparity + 2){
+            return finish(range, t);
+        }
+
+        //Rectify the template and the search strip only, x in the right eye is x in the left minus the disparity
+        Rect stripRect(u - maxDisparity - half, v - half, maxDisparity - MinDisparity + Patch, Patch);
+        remap(left, patchC, calib.Map11(patchRect), calib.Map12(patchRect), INTER_LINEAR);
+        remap(right, stripC, calib.Map21(stripRect), calib.Map22(stripRect), INTER_LINEAR);
+        grey(patchC, patch);
+        grey(stripC, strip);
+
+        //A flat template correlates with anything
+        Scalar mean, stddev;
+        meanStdDev(patch, mean, stddev);
+        if (stddev[0] < MinContrast){
+            return finish(range, t);
+        }
+
+        matchTemplate(strip, patch, score, TM_CCOEFF_NORMED);
+        const float *s = score.ptr<float>(0);
+        int n = score.cols, best = 0;
+        for (int i = 1; i < n; i++){
+            if (s[i] > s[best]) best = i;
+        }
+        float second = 0;
+        for (int i = 0; i < n; i++){
+            if (abs(i - best) > 2 && s[i] > second) second = s[i];
+        }
+
+        //Parabola through the peak and its neighbours, score index i is disparity maxDisparity - i
+        double offset = 0;
+        if (best > 0 && best < n - 1){
+            double den = s[best - 1] - 2*s[best] + s[best + 1];
+            if (den < 0){
+                offset = 0.5*(s[best - 1] - s[best + 1])/den;
+            }
+        }
+        double d = maxDisparity - (best + offset);
+
+        //[X Y Z W] = Q [x y d 1]
+        const double *q = calib.Q.ptr<double>();
+        double Z = q[8]*pr.x + q[9]*pr.y + q[10]*d + q[11];
+        double W = q[12]*pr.x + q[13]*pr.y + q[14]*d + q[15];
+        if (W <= 0){
+            return finish(range, t);
+        }
+        range.Distance = (float)(Z/W);
+        range.Disparity = (float)d;
+        range.Confidence = min(max(s[best] - second, 0.f), 1.f);
+        return finish(range, t);
+    }
+
+    int Patch;           // template size in pixels, odd
+    int MinDisparity;    // search range in rectified pixels
+    int MaxDisparity;
+    double MinContrast;  // grey level standard deviation below which the template is too flat to match
+
+private:
+    static void grey(const Mat &src, Mat &dst){
+        if (src.channels() == 3){
+            cvtColor(src, dst, COLOR_BGR2GRAY);
+        }
+        else{
+            dst = src;
+        }
+    }
+
+    static OwlGazeRange finish(OwlGazeRange range, int64 start){
+        range.Ms = (float)((getTickCount() - start)*1000./getTickFrequency());
+        return range;
+    }
+
+    OwlCalibration calib;
+    Mat patchC, stripC, patch, strip, score;
+};
+
+#endif // OWLRANGE_H
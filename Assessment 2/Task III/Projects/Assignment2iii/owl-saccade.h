@@ -0,0 +1,101 @@
+#ifndef OWLSACCADE_H
+#define OWLSACCADE_H
+
+/* Non-blocking servo commands for the OWL
+ * (c) Plymouth University
+ *
+ * OwlSendPacket waits for the 'OK' from the Pi, which takes up to 1.5 s while the video is
+ * streaming. OwlServoMailbox sends from its own thread, so the vision loop only posts the
+ * latest servo position and carries on. A position posted while the previous one is still
+ * being sent replaces any older unsent one, only the newest target matters for a saccade.
+ *
+ * Include after owl-comms.h, which has no include guard around its functions.
+ */
+#include <sstream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <opencv2/core/core.hpp>
+
+using namespace std;
+
+class OwlServoMailbox {
+public:
+    OwlServoMailbox() : sock(0), sent(0), pending(false), sending(false), stop(false){}
+    ~OwlServoMailbox(){ close(); }
+
+    void start(SOCKET s){
+        sock = s;
+        stop = false;
+        worker = thread([this]{ run(); });
+    }
+
+    //Queue a servo position, replaces a position that has not been sent yet. Never blocks on the socket
+    void post(int rx, int ry, int lx, int ly, int neck){
+        lock_guard<mutex> lock(m);
+        next[0] = rx; next[1] = ry; next[2] = lx; next[3] = ly; next[4] = neck;
+        pending = true;
+        wake.notify_one();
+    }
+
+    //True when every posted position has been acknowledged by the Pi
+    bool idle(){
+        lock_guard<mutex> lock(m);
+        return !pending && !sending;
+    }
+
+    void close(){
+        {
+            lock_guard<mutex> lock(m);
+            stop = true;
+            wake.notify_one();
+        }
+        if (worker.joinable()){
+            worker.join();
+        }
+    }
+
+    //Tick count when the last position was acknowledged
+    int64 lastSent(){
+        lock_guard<mutex> lock(m);
+        return sent;
+    }
+
+private:
+    void run(){
+        for (;;){
+            int cmd[5];
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait(lock, [this]{ return pending || stop; });
+                if (stop){
+                    return;
+                }
+                for (int i = 0; i < 5; i++){
+                    cmd[i] = next[i];
+                }
+                pending = false;
+                sending = true;
+            }
+            ostringstream CMDstream;
+            CMDstream << cmd[0] << " " << cmd[1] << " " << cmd[2] << " " << cmd[3] << " " << cmd[4];
+            OwlSendPacket(sock, CMDstream.str());
+
+            lock_guard<mutex> lock(m);
+            sending = false;
+            sent = cv::getTickCount();
+        }
+    }
+
+    SOCKET sock;
+    int64 sent;
+    int next[5];
+    bool pending, sending, stop;
+    mutex m;
+    condition_variable wake;
+    thread worker;
+};
+
+#endif // OWLSACCADE_H
@@ -0,0 +1,543 @@
+#ifndef OWLSALIENCY_H
+#define OWLSALIENCY_H
+
+/* Saliency engine for the OWL attention model
+ * (c) Plymouth University
+ *
+ * The engine holds a registry of feature maps (see owl-featuremaps.h). Every map keeps its
+ * last output and is only recomputed when its input changed:
+ *   image      -> Grey and the FEATURE_BGR / FEATURE_GREY maps
+ *   gaze       -> the FEATURE_GAZE maps
+ *   parameters -> whatever map marks itself dirty in setParams (the Canny thresholds)
+ * The weighted combination runs every step, as the familiarity map changes after every
+ * saccade, so a weight change costs nothing more than the combination itself.
+ * Grey is computed first, the dirty maps do not depend on each other and run as concurrent
+ * tasks on OpenCV's thread pool, joined before the combination.
+ *
+ * Familiarity is kept as a low resolution inhibition of return store, see InhibitionMap.
+ * By default it covers the image. setWorld() makes it cover a larger world, e.g. every
+ * position the eyes can reach, and setOrigin() places the image in it, so what has been
+ * looked at stays inhibited after the eyes move.
+ * The combination, the familiarity gain and the argmax are one row parallel pass over the
+ * maps, see SaliencyEngine::combine. With FixedPoint set the pass reads only 8 bit maps and
+ * accumulates in saturating 16 bit, see combineRowFixed.
+ */
+#include <vector>
+#include <string>
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "owl-featuremaps.h"
+
+using namespace std;
+using namespace cv;
+
+// Inhibition of return at 1/Scale resolution, familiarity = 1 - inhibition
+// Every attend() decays the whole map by (1-w) and adds w times a Gaussian stamp at the
+// target. The decay is lazy, the stored J is scaled by S (inhibition = S*J), so an update
+// only touches the pixels under the stamp. Low resolution cell i is centred on full
+// resolution pixel Scale*i + (Scale-1)/2, the same grid resize() uses, and the map is read
+// back one row at a time with bilinear interpolation.
+// Positions are in map coordinates, which are image coordinates offset by the origin the
+// caller passes to prepare(), so the map can cover more than one view.
+class InhibitionMap {
+public:
+    InhibitionMap() : Scale(8), S(1){}
+
+    //Clear the store for a map of the given full resolution size, sigma in full resolution pixels
+    void create(Size size, int scale, double sigma){
+        Scale = scale;
+        Full = size;
+        J = Mat::zeros((size.height + scale - 1)/scale, (size.width + scale - 1)/scale, CV_32FC1);
+        S = 1;
+        double s = sigma/scale;
+        int r = cvCeil(3*s);
+        Mat g = getGaussianKernel(2*r + 1, s, CV_32F);
+        stamp = g*g.t();
+        stamp /= stamp.at<float>(r, r); //peak of 1, so the inhibition stays within 0..1
+    }
+
+    void attend(Point2f target, double w){
+        if (J.empty() || w <= 0){
+            return;
+        }
+        double decayed = S*(1 - w);
+        if (decayed < 1e-4){ //fold the scale back into J before w/S loses precision
+            J *= decayed;
+            S = 1;
+        }
+        else{
+            S = decayed;
+        }
+
+        //Shift the stamp by the sub-cell part of the target and add it around the target cell
+        Point2f c((target.x + 0.5f)/Scale - 0.5f, (target.y + 0.5f)/Scale - 0.5f);
+        Point ci(cvFloor(c.x), cvFloor(c.y));
+        int r = stamp.rows/2;
+        Mat shift = (Mat_<double>(2,3) << 1, 0, c.x - ci.x, 0, 1, c.y - ci.y);
+        warpAffine(stamp, shifted, shift, Size(stamp.cols + 1, stamp.rows + 1), INTER_LINEAR, BORDER_CONSTANT);
+
+        Rect dst(ci.x - r, ci.y - r, shifted.cols, shifted.rows);
+        Rect clip = dst & Rect(0, 0, J.cols, J.rows);
+        if (clip.area() == 0){
+            return;
+        }
+        Mat roi = J(clip);
+        scaleAdd(shifted(clip - dst.tl()), w/S, roi, roi);
+    }
+
+    //Column tables for the size(size) window at origin, call once before row()
+    void prepare(Point origin, Size size){
+        Origin = origin;
+        x0.resize(size.width);
+        x1.resize(size.width);
+        xw.resize(size.width);
+        for (int x = 0; x < size.width; x++){
+            float fx = max((origin.x + x + 0.5f)/Scale - 0.5f, 0.f);
+            x0[x] = min(cvFloor(fx), J.cols - 1);
+            x1[x] = min(x0[x] + 1, J.cols - 1);
+            xw[x] = fx - cvFloor(fx);
+        }
+    }
+
+    //Familiarity (0..1) of window row y into dst, tmp holds Cols() floats
+    //Only reads the store, so rows can be filled from several threads
+    void row(int y, float *dst, float *tmp) const {
+        float fy = max((Origin.y + y + 0.5f)/Scale - 0.5f, 0.f);
+        int j0 = min(cvFloor(fy), J.rows - 1), j1 = min(j0 + 1, J.rows - 1);
+        float a = fy - cvFloor(fy);
+        const float *r0 = J.ptr<float>(j0), *r1 = J.ptr<float>(j1);
+        for (int i = 0; i < J.cols; i++){
+            tmp[i] = 1 - (float)S*(r0[i] + a*(r1[i] - r0[i]));
+        }
+        for (size_t x = 0; x < x0.size(); x++){
+            dst[x] = tmp[x0[x]] + xw[x]*(tmp[x1[x]] - tmp[x0[x]]);
+        }
+    }
+
+    //Same as row(), as 8 bit familiarity 0..255
+    void row8(int y, uchar *dst, float *tmp) const {
+        float fy = max((Origin.y + y + 0.5f)/Scale - 0.5f, 0.f);
+        int j0 = min(cvFloor(fy), J.rows - 1), j1 = min(j0 + 1, J.rows - 1);
+        float a = fy - cvFloor(fy);
+        const float *r0 = J.ptr<float>(j0), *r1 = J.ptr<float>(j1);
+        for (int i = 0; i < J.cols; i++){
+            tmp[i] = 255*(1 - (float)S*(r0[i] + a*(r1[i] - r0[i])));
+        }
+        for (size_t x = 0; x < x0.size(); x++){
+            dst[x] = saturate_cast<uchar>(tmp[x0[x]] + xw[x]*(tmp[x1[x]] - tmp[x0[x]]));
+        }
+    }
+
+    int Cols() const { return J.cols; }
+
+    int Scale;
+    Size Full;
+    Point Origin;
+
+private:
+    Mat J, stamp, shifted;
+    double S;
+    vector<int> x0, x1;
+    vector<float> xw;
+};
+
+class SaliencyEngine {
+public:
+    vector<Ptr<FeatureMap> > Maps; // combined in this order
+    Mat Grey;        // grey input shared by the FEATURE_GREY maps
+    Mat Familiar;    // familiarity 0..1 (0..255 8 bit in fixed point), 1 = never looked at, only kept with keepMaps
+    Mat Salience;    // last salience map, CV_32FC1 normalised to 0..255, only kept with keepMaps
+    bool FixedPoint; // combine 8 bit maps with 16 bit fixed point weights instead of floats
+    double GreyMs;   // time of the last grey conversion
+    double CombineMs;// time of the last combine
+    double MapsMs;   // wall time of the last feature map stage, each map has its own Ms
+    float PeakValue; // combined value at the returned point before normalisation (integer sums in fixed point)
+    float LowValue;  // lowest combined value before normalisation, Salience 0..255 spans LowValue..PeakValue
+
+    //Starts with the maps of the original model, in the order they used to be summed, then the Itti & Koch map
+    SaliencyEngine() : FixedPoint(false), GreyMs(0), CombineMs(0), MapsMs(0), PeakValue(0), LowValue(0), greyDirty(true), gaze(-1, -1), params(), paramsSet(false){
+        add(makePtr<DoGLowMap>());
+        add(makePtr<FoveaMap>());
+        add(makePtr<CannyMap>());
+        add(makePtr<StrongColourMap>());
+        add(makePtr<IttiKochMap>());
+    }
+
+    //Register a map, it keeps its own weight until the first setParams
+    void add(Ptr<FeatureMap> map){
+        if (paramsSet){
+            map->setParams(params);
+        }
+        map->Dirty = true;
+        Maps.push_back(map);
+    }
+
+    //Registered map by name, or 0
+    FeatureMap *map(const string &name){
+        for (size_t i = 0; i < Maps.size(); i++){
+            if (Maps[i]->Name == name){
+                return Maps[i].get();
+            }
+        }
+        return 0;
+    }
+
+    //Keep familiarity in a world of this size (full resolution pixels) instead of the image
+    void setWorld(Size size){
+        world = size;
+        inhibition.create(size, 8, 50);
+    }
+
+    //Position of the image in the world, clamped so the image stays inside it
+    void setOrigin(Point o){
+        origin = o;
+    }
+
+    //New input image, all image based maps become dirty
+    void setImage(const Mat &bgr){
+        bool resized = image.size() != bgr.size();
+        image = bgr;
+        greyDirty = true;
+        for (size_t i = 0; i < Maps.size(); i++){
+            if (Maps[i]->Input != FEATURE_GAZE || resized){
+                Maps[i]->Dirty = true;
+            }
+        }
+        if (resized && world.area() == 0){
+            inhibition.create(bgr.size(), 8, 50);
+        }
+    }
+
+    void setGaze(Point g){
+        if (g != gaze){
+            gaze = g;
+            for (size_t i = 0; i < Maps.size(); i++){
+                if (Maps[i]->Input == FEATURE_GAZE){
+                    Maps[i]->Dirty = true;
+                }
+            }
+        }
+    }
+
+    void setParams(const SaliencyParams &p){
+        params = p;
+        paramsSet = true;
+        for (size_t i = 0; i < Maps.size(); i++){
+            Maps[i]->setParams(p);
+        }
+    }
+
+    //Recompute the dirty maps, combine them and return the most salient point
+    //keepMaps also writes out Salience and Familiar for display
+    Point compute(bool keepMaps = true){
+        int64 t = getTickCount();
+        if (greyDirty){
+            cvtColor(image, Grey, COLOR_BGR2GRAY);
+            GreyMs = (getTickCount() - t)*1000./getTickFrequency();
+            greyDirty = false;
+        }
+
+        FeatureInputs in;
+        in.Bgr = image;
+        in.Grey = Grey;
+        in.Gaze = gaze;
+        vector<FeatureMap*> tasks;
+        for (size_t i = 0; i < Maps.size(); i++){
+            //a map without weight stays dirty and is computed once it gets one
+            if (Maps[i]->Enabled && Maps[i]->Weight > 0 && Maps[i]->Dirty){
+                tasks.push_back(Maps[i].get());
+            }
+        }
+        //one task per stripe, so every map runs on its own worker
+        parallel_for_(Range(0, (int)tasks.size()), [&](const Range &range){
+            for (int i = range.start; i < range.end; i++){
+                run(*tasks[i], in);
+            }
+        }, (double)tasks.size());
+        MapsMs = (getTickCount() - t)*1000./getTickFrequency();
+
+        return combine(keepMaps);
+    }
+
+    //Combined value before normalisation of a Salience value, e.g. of a later peak of the same map
+    float raw(float salience) const {
+        return LowValue + salience*(PeakValue - LowValue)/255;
+    }
+
+    //Update Familarity Map, to inhibit salient targets once observed (this is a global map)
+    //target is in image coordinates
+    void attend(Point target){
+        inhibition.attend(target + view(), params.FamiliarWeight/100.);
+    }
+
+private:
+    //Compute one map and bring it into the formats the combine reads
+    void run(FeatureMap &map, const FeatureInputs &in){
+        int64 t = getTickCount();
+        map.compute(in, map.Map);
+        CV_Assert(map.Map.type() == CV_8UC1 || map.Map.type() == CV_32FC1);
+        if (map.Map.size() != image.size()){
+            resize(map.Map, map.Full, image.size(), 0, 0, INTER_LINEAR);
+        }
+        else{
+            map.Full = map.Map;
+        }
+        if (map.Full.type() != CV_8UC1){
+            map.Full.convertTo(map.Full8, CV_8U); //negative responses clamp to 0 for the fixed point path
+        }
+        else{
+            map.Full8 = map.Full;
+        }
+        map.Ms = (getTickCount() - t)*1000./getTickFrequency();
+        map.Bytes = map.stateBytes() + bytes(map.Map) + (map.Full.data != map.Map.data ? bytes(map.Full) : 0)
+                  + (map.Full8.data != map.Full.data ? bytes(map.Full8) : 0);
+        map.Computed++;
+        map.Dirty = false;
+    }
+
+    static size_t bytes(const Mat &m){ return m.isSubmatrix() ? 0 : m.total()*m.elemSize(); }
+
+    //Origin of the image in the familiarity store
+    Point view() const {
+        return Point(min(max(origin.x, 0), max(inhibition.Full.width - image.cols, 0)),
+                     min(max(origin.y, 0), max(inhibition.Full.height - image.rows, 0)));
+    }
+
+    //Linear combination of feature maps times familiarity, and its argmax, in one pass
+    //Each stripe of rows reads every map once, the running max is kept per stripe and the
+    //stripes are merged in raster order so ties resolve like minMaxLoc
+    Point combine(bool keepMaps){
+        int64 t = getTickCount();
+        Size size = image.size();
+        if (keepMaps){
+            Salience.create(size, CV_32FC1);
+            Familiar.create(size, FixedPoint ? CV_8UC1 : CV_32FC1);
+        }
+        inhibition.prepare(view(), size);
+        active.clear();
+        fixedWeights.clear();
+        int fixedTotal = 0;
+        for (size_t i = 0; i < Maps.size(); i++){
+            if (Maps[i]->Enabled && Maps[i]->Weight > 0 && !Maps[i]->Full.empty()){
+                active.push_back(Maps[i].get());
+                fixedWeights.push_back((ushort)((Maps[i]->Weight*64 + 50)/100));
+                fixedTotal += fixedWeights.back();
+            }
+        }
+        //keep the fixed point sum within 16 bits however many maps are active
+        if (fixedTotal > 257){
+            for (size_t i = 0; i < fixedWeights.size(); i++){
+                fixedWeights[i] = (ushort)(fixedWeights[i]*257/fixedTotal);
+            }
+        }
+
+        const int stripeRows = 16;
+        int stripes = (size.height + stripeRows - 1)/stripeRows;
+        vector<float> stripeMax(stripes), stripeMin(stripes);
+        vector<Point> stripeBest(stripes);
+        size_t scratchBytes = size.width*(sizeof(float) + sizeof(uint32_t)) + inhibition.Cols()*sizeof(float);
+
+        parallel_for_(Range(0, stripes), [&](const Range &range){
+            vector<uchar> scratch(scratchBytes);
+            for (int s = range.start; s < range.end; s++){
+                float best = -FLT_MAX, lowest = FLT_MAX;
+                Point bestLoc(0, s*stripeRows);
+                for (int y = s*stripeRows; y < min((s + 1)*stripeRows, size.height); y++){
+                    int x = FixedPoint ? combineRowFixed(y, keepMaps, &scratch[0], best, lowest)
+                                       : combineRow(y, keepMaps, &scratch[0], best, lowest);
+                    if (x >= 0){
+                        bestLoc = Point(x, y);
+                    }
+                }
+                stripeMax[s] = best;
+                stripeMin[s] = lowest;
+                stripeBest[s] = bestLoc;
+            }
+        });
+
+        int bestStripe = 0;
+        float lowest = stripeMin[0];
+        for (int s = 1; s < stripes; s++){
+            if (stripeMax[s] > stripeMax[bestStripe]){
+                bestStripe = s;
+            }
+            lowest = min(lowest, stripeMin[s]);
+        }
+
+        PeakValue = stripeMax[bestStripe];
+        LowValue = lowest;
+
+        //Same 0..255 range the separate normalize used to give
+        if (keepMaps){
+            float range = stripeMax[bestStripe] - lowest;
+            double scale = range > 0 ? 255./range : 0;
+            Salience.convertTo(Salience, CV_32FC1, scale, -lowest*scale);
+        }
+        CombineMs = (getTickCount() - t)*1000./getTickFrequency();
+        return stripeBest[bestStripe];
+    }
+
+    //acc += w*src over a row
+    static void accumulate(float *acc, const uchar *src, float w, int width){
+        int x = 0;
+#if CV_SIMD128
+        v_float32x4 vw = v_setall_f32(w);
+        for (; x <= width - 4; x += 4){
+            v_float32x4 v = v_cvt_f32(v_reinterpret_as_s32(v_load_expand_q(src + x)));
+            v_store(acc + x, v_load(acc + x) + v*vw);
+        }
+#endif
+        for (; x < width; x++){
+            acc[x] += src[x]*w;
+        }
+    }
+
+    static void accumulate(float *acc, const float *src, float w, int width){
+        int x = 0;
+#if CV_SIMD128
+        v_float32x4 vw = v_setall_f32(w);
+        for (; x <= width - 4; x += 4){
+            v_store(acc + x, v_load(acc + x) + v_load(src + x)*vw);
+        }
+#endif
+        for (; x < width; x++){
+            acc[x] += src[x]*w;
+        }
+    }
+
+    //acc += w*src with saturating 16 bit adds
+    static void accumulate(ushort *acc, const uchar *src, ushort w, int width){
+        int x = 0;
+#if CV_SIMD128
+        v_uint16x8 vw = v_setall_u16(w);
+        for (; x <= width - 8; x += 8){
+            v_store(acc + x, v_load(acc + x) + v_load_expand(src + x)*vw);
+        }
+#endif
+        for (; x < width; x++){
+            acc[x] = (ushort)min(acc[x] + src[x]*w, 65535);
+        }
+    }
+
+    //Float row of the combination. Updates lowest, and returns the column of the row maximum
+    //if it beats best (which is updated), otherwise -1
+    int combineRow(int y, bool keepMaps, uchar *scratch, float &best, float &lowest){
+        int width = image.cols;
+        float *famRow = (float*)scratch, *salRow = famRow + width, *tmp = salRow + width;
+        float *fam = keepMaps ? Familiar.ptr<float>(y) : famRow;
+        float *sal = keepMaps ? Salience.ptr<float>(y) : salRow;
+        inhibition.row(y, fam, tmp);
+
+        //weighted sum straight into the salience row, one map at a time while the row is in cache
+        memset(sal, 0, width*sizeof(float));
+        for (size_t i = 0; i < active.size(); i++){
+            const Mat &m = active[i]->Full;
+            if (m.type() == CV_8UC1){
+                accumulate(sal, m.ptr<uchar>(y), (float)active[i]->Weight, width);
+            }
+            else{
+                accumulate(sal, m.ptr<float>(y), (float)active[i]->Weight, width);
+            }
+        }
+
+        int x = 0;
+        float rowMax = -FLT_MAX, rowMin = FLT_MAX;
+#if CV_SIMD128
+        v_float32x4 vMax = v_setall_f32(-FLT_MAX), vMin = v_setall_f32(FLT_MAX);
+        for (; x <= width - 4; x += 4){
+            v_float32x4 v = v_load(sal + x)*v_load(fam + x);
+            v_store(sal + x, v);
+            vMax = v_max(vMax, v);
+            vMin = v_min(vMin, v);
+        }
+        rowMax = v_reduce_max(vMax);
+        rowMin = v_reduce_min(vMin);
+#endif
+        for (; x < width; x++){
+            float v = sal[x]*fam[x];
+            sal[x] = v;
+            rowMax = max(rowMax, v);
+            rowMin = min(rowMin, v);
+        }
+
+        lowest = min(lowest, rowMin);
+        if (rowMax <= best){ //only rows with a new maximum are searched for its column
+            return -1;
+        }
+        best = rowMax;
+        for (x = 0; sal[x] != rowMax; x++){}
+        return x;
+    }
+
+    //Fixed point row: the 8 bit maps are weighted by 0..64 (the 0..100 weights rescaled, and
+    //scaled down together if they add up to more than 257) and summed with saturating 16 bit
+    //adds, so the sum never saturates. The sum>>2 times the 8 bit familiarity is the 32 bit
+    //salience. Float maps are read clamped to 0..255, so a negative DoG no longer lowers the salience.
+    int combineRowFixed(int y, bool keepMaps, uchar *scratch, float &best, float &lowest){
+        int width = image.cols;
+        uint32_t *sal = (uint32_t*)scratch;
+        float *tmp = (float*)(sal + width);
+        ushort *sum = (ushort*)(tmp + inhibition.Cols());
+        uchar *fam = keepMaps ? Familiar.ptr<uchar>(y) : (uchar*)(sum + width);
+        inhibition.row8(y, fam, tmp);
+
+        memset(sum, 0, width*sizeof(ushort));
+        for (size_t i = 0; i < active.size(); i++){
+            accumulate(sum, active[i]->Full8.ptr<uchar>(y), fixedWeights[i], width);
+        }
+
+        int x = 0;
+        uint32_t rowMax = 0, rowMin = UINT32_MAX;
+#if CV_SIMD128
+        v_uint32x4 vMax = v_setall_u32(0), vMin = v_setall_u32(UINT32_MAX);
+        for (; x <= width - 8; x += 8){
+            v_uint32x4 lo, hi;
+            v_mul_expand(v_load(sum + x) >> 2, v_load_expand(fam + x), lo, hi);
+            v_store(sal + x, lo);
+            v_store(sal + x + 4, hi);
+            vMax = v_max(vMax, v_max(lo, hi));
+            vMin = v_min(vMin, v_min(lo, hi));
+        }
+        rowMax = v_reduce_max(vMax);
+        rowMin = v_reduce_min(vMin);
+#endif
+        for (; x < width; x++){
+            sal[x] = (uint32_t)(sum[x] >> 2)*fam[x];
+            rowMax = max(rowMax, sal[x]);
+            rowMin = min(rowMin, sal[x]);
+        }
+        if (keepMaps){
+            float *out = Salience.ptr<float>(y);
+            for (x = 0; x < width; x++){
+                out[x] = (float)sal[x];
+            }
+        }
+
+        //at most 16383*255, exact as a float
+        lowest = min(lowest, (float)rowMin);
+        if ((float)rowMax <= best){
+            return -1;
+        }
+        best = (float)rowMax;
+        for (x = 0; sal[x] != rowMax; x++){}
+        return x;
+    }
+
+    Mat image;
+    Size world;
+    Point origin;
+    bool greyDirty;
+    vector<FeatureMap*> active; // maps in the current combine
+    vector<ushort> fixedWeights; // their weights for the fixed point combine
+    InhibitionMap inhibition;
+    Point gaze;
+    SaliencyParams params;
+    bool paramsSet;
+};
+
+#endif // OWLSALIENCY_H
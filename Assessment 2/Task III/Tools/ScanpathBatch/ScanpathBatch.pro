@@ -0,0 +1,23 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+INCLUDEPATH += C:\openCV343\release\install\include
+INCLUDEPATH += ../../Projects/Assignment2iii
+INCLUDEPATH += ../../../Common
+
+LIBS+= C:\openCV343\release\bin\libopencv_core343.dll
+LIBS+= C:\openCV343\release\bin\libopencv_imgcodecs343.dll
+LIBS+= C:\openCV343\release\bin\libopencv_imgproc343.dll
+
+SOURCES += \
+    scanpath_batch.cpp
+
+HEADERS += \
+    ../../Projects/Assignment2iii/owl-features.h \
+    ../../Projects/Assignment2iii/owl-featuremaps.h \
+    ../../Projects/Assignment2iii/owl-saliency.h \
+    ../../Projects/Assignment2iii/owl-peaks.h \
+    ../../../Common/owl-mmap.h \
+    ../../../Common/owl-dataset.h
@@ -0,0 +1,179 @@
+/* Batch scanpath evaluation for the OWL saliency model
+ *
+ * Runs the saccade loop of Assignment2iii for a number of steps on every salient target
+ * image, one image per task in parallel, and writes each scanpath to <out><image>.csv:
+ * every fixation, its combined salience before normalisation and the time of the compute
+ * and attend. With -scanpath K each compute plans K fixations like the app does.
+ * The weights are options, so a weight change or a performance regression can be checked
+ * on all images in one run instead of by watching the GUI on one sample.
+ */
+#include "opencv2/core/utility.hpp"
+#include "opencv2/imgcodecs.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "owl-dataset.h"
+#include "owl-saliency.h"
+#include "owl-peaks.h"
+
+using namespace cv;
+using namespace std;
+
+struct ScanpathStep {
+    int Step, Fixation;  // saliency computation, and fixation planned from it
+    Point Gaze;
+    float Salience;      // combined value before the 0..255 normalisation
+    double ComputeMs, AttendMs;  // the compute (and peak extraction) is counted on the first fixation of a step
+};
+
+//The saccade loop of the app: compute, look at the most salient point(s) and inhibit them
+static vector<ScanpathStep> scanpath(const Mat &img, const SaliencyParams &params, bool fixedPoint, int steps, int fixations, int radius)
+{
+    SaliencyEngine engine;
+    engine.FixedPoint = fixedPoint;
+    engine.setParams(params);
+    engine.setImage(img);
+    SaliencePeaks peaks;
+
+    vector<ScanpathStep> path;
+    Point gaze(img.cols/2, img.rows/2);
+    for (int step = 0; step < steps; step++){
+        engine.setGaze(gaze);
+        int64 t = getTickCount();
+        gaze = engine.compute(fixations > 1);
+        vector<Point> targets(1, gaze);
+        vector<float> values(1, engine.PeakValue);
+        if (fixations > 1){
+            //the peaks come from the normalised Salience, raw() maps them back
+            peaks.build(engine.Salience);
+            values.clear();
+            targets = peaks.top(fixations, radius, &values);
+            for (size_t i = 0; i < values.size(); i++){
+                values[i] = engine.raw(values[i]);
+            }
+            if (targets.empty()){
+                targets.assign(1, gaze);
+                values.assign(1, engine.PeakValue);
+            }
+        }
+        double computeMs = (getTickCount() - t)*1000./getTickFrequency();
+
+        for (size_t i = 0; i < targets.size(); i++){
+            ScanpathStep s;
+            s.Step = step;
+            s.Fixation = (int)i;
+            s.Gaze = targets[i];
+            s.Salience = values[i];
+            s.ComputeMs = i == 0 ? computeMs : 0;
+            t = getTickCount();
+            engine.attend(targets[i]);
+            s.AttendMs = (getTickCount() - t)*1000./getTickFrequency();
+            path.push_back(s);
+        }
+        gaze = targets.back();
+    }
+    return path;
+}
+
+static bool writeCsv(const string &path, const vector<ScanpathStep> &steps)
+{
+    ofstream out(path.c_str());
+    if (!out.is_open()){
+        cout << "Can not write " << path << endl;
+        return false;
+    }
+    out << "step,fixation,x,y,salience,compute_ms,attend_ms" << endl;
+    for (size_t i = 0; i < steps.size(); i++){
+        const ScanpathStep &s = steps[i];
+        out << s.Step << "," << s.Fixation << "," << s.Gaze.x << "," << s.Gaze.y << "," << s.Salience << "," << s.ComputeMs << "," << s.AttendMs << endl;
+    }
+    return out.good();
+}
+
+int main(int argc, char** argv)
+{
+    cv::CommandLineParser parser(argc, argv,
+        "{samples|../../Data/Task 3 Salient Targets|folder of the salient target images}"
+        "{store|../../Data/salient.owlpack|decoded image store written by DatasetPack, used when present}"
+        "{out|../../Data/scanpath_|prefix of the csv files, the image name is appended}"
+        "{steps|50|saliency computations per image}"
+        "{scanpath|1|fixations planned from each computation}"
+        "{radius|60|pixels a planned fixation keeps clear of the ones before it}"
+        "{colour|60|}{doghigh|60|}{doglow|30|}{familiar|5|}{fovea|50|}{ittikoch|0|weight of the Itti & Koch map, 0 leaves it out}"
+        "{cannylow|200|}{cannyhigh|300|}"
+        "{fixed||combine in fixed point}{help||}");
+    if (parser.has("help")){
+        parser.printMessage();
+        return 0;
+    }
+
+    string root = parser.get<string>("samples");
+    vector<String> found;
+    glob(root + "/*.jpg", found, false);
+    if (found.empty()){
+        cout << "No images found in " << root << endl;
+        return 1;
+    }
+
+    //Decode up front, so the timings are the model only
+    OwlDataset dataset;
+    dataset.open(parser.get<string>("store"));
+    vector<string> names;
+    vector<Mat> images;
+    for (size_t i = 0; i < found.size(); i++){
+        string name = found[i].substr(root.size() + 1);
+        name = name.substr(0, name.rfind('.'));
+        Mat img;
+        if (dataset.isOpened()){
+            img = dataset.frame(name);
+        }
+        if (img.empty()){
+            img = imread(found[i]);
+        }
+        if (img.empty()){
+            cout << "Can not read " << found[i] << endl;
+            continue;
+        }
+        names.push_back(name);
+        images.push_back(img);
+    }
+
+    SaliencyParams params = {parser.get<int>("colour"), parser.get<int>("doghigh"), parser.get<int>("doglow"),
+                             parser.get<int>("familiar"), parser.get<int>("fovea"), parser.get<int>("ittikoch"),
+                             parser.get<int>("cannylow"), parser.get<int>("cannyhigh")};
+    bool fixedPoint = parser.has("fixed");
+    int steps = max(parser.get<int>("steps"), 1);
+    int fixations = max(parser.get<int>("scanpath"), 1);
+    int radius = parser.get<int>("radius");
+
+    //One image per task, each with its own engine. The feature maps and the combine of an
+    //engine run their parallel_for_ inline when they are already inside this one
+    vector<vector<ScanpathStep> > paths(images.size());
+    int64 t = getTickCount();
+    parallel_for_(Range(0, (int)images.size()), [&](const Range &range){
+        for (int i = range.start; i < range.end; i++){
+            paths[i] = scanpath(images[i], params, fixedPoint, steps, fixations, radius);
+        }
+    }, (double)images.size());
+    double totalMs = (getTickCount() - t)*1000./getTickFrequency();
+
+    bool ok = true;
+    string prefix = parser.get<string>("out");
+    for (size_t i = 0; i < images.size(); i++){
+        double computeMs = 0, attendMs = 0;
+        for (size_t s = 0; s < paths[i].size(); s++){
+            computeMs += paths[i][s].ComputeMs;
+            attendMs += paths[i][s].AttendMs;
+        }
+        string file = prefix + names[i] + ".csv";
+        ok = writeCsv(file, paths[i]) && ok;
+        cout << names[i] << ": " << images[i].cols << "x" << images[i].rows << ", compute " << computeMs/steps
+             << "ms/step, attend " << attendMs/steps << "ms/step, last gaze " << paths[i].back().Gaze << " -> " << file << endl;
+    }
+    cout << images.size() << " images x " << steps << " steps in " << totalMs << "ms on " << getNumThreads() << " threads" << endl;
+    return ok ? 0 : 1;
+}